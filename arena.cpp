@@ -0,0 +1,36 @@
+#include "arena.hpp"
+
+arena::arena(std::size_t block_size)
+    : m_cur(nullptr), m_end(nullptr), m_block_size(block_size),
+      m_capacity(0) {}
+
+arena::~arena() { release(); }
+
+// Starts a new block. Requests larger than a block get a block of their
+// own so the remainder of the current one is not wasted.
+void *arena::allocateSlow(std::size_t size, std::size_t align) {
+  std::size_t need = size + align - 1;
+  if (need > m_block_size / 4) {
+    char *block = static_cast<char *>(::operator new(need));
+    m_blocks.push_back(block);
+    m_capacity += need;
+    std::uintptr_t p = reinterpret_cast<std::uintptr_t>(block);
+    p = (p + align - 1) & ~(std::uintptr_t)(align - 1);
+    return reinterpret_cast<void *>(p);
+  }
+
+  char *block = static_cast<char *>(::operator new(m_block_size));
+  m_blocks.push_back(block);
+  m_capacity += m_block_size;
+  m_cur = block;
+  m_end = block + m_block_size;
+  return allocate(size, align);
+}
+
+void arena::release() {
+  for (char *block : m_blocks)
+    ::operator delete(block);
+  m_blocks.clear();
+  m_cur = m_end = nullptr;
+  m_capacity = 0;
+}
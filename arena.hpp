@@ -0,0 +1,66 @@
+#pragma once
+
+//
+// A bump-pointer arena
+//
+// Memory is carved out of large blocks and released all at once when the
+// arena is destroyed. Nothing allocated here has its destructor run.
+//
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+class arena {
+public:
+  static constexpr std::size_t default_block_size = 64 * 1024;
+
+  explicit arena(std::size_t block_size = default_block_size);
+  ~arena();
+
+  arena(const arena &) = delete;
+  arena &operator=(const arena &) = delete;
+
+  void *allocate(std::size_t size,
+                 std::size_t align = alignof(std::max_align_t));
+
+  template <typename T, typename... Args> T *make(Args &&...args) {
+    return new (allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+  }
+
+  // Frees every block.
+  void release();
+
+  void swap(arena &other) {
+    std::swap(m_cur, other.m_cur);
+    std::swap(m_end, other.m_end);
+    std::swap(m_block_size, other.m_block_size);
+    std::swap(m_capacity, other.m_capacity);
+    m_blocks.swap(other.m_blocks);
+  }
+
+  // The number of bytes obtained from the system.
+  std::size_t getCapacity() const { return m_capacity; }
+
+private:
+  void *allocateSlow(std::size_t size, std::size_t align);
+
+  char *m_cur;
+  char *m_end;
+  std::size_t m_block_size;
+  std::size_t m_capacity;
+  std::vector<char *> m_blocks;
+};
+
+inline void *arena::allocate(std::size_t size, std::size_t align) {
+  std::uintptr_t p = reinterpret_cast<std::uintptr_t>(m_cur);
+  p = (p + align - 1) & ~(std::uintptr_t)(align - 1);
+  if (m_cur && p + size <= reinterpret_cast<std::uintptr_t>(m_end)) {
+    m_cur = reinterpret_cast<char *>(p + size);
+    return reinterpret_cast<void *>(p);
+  }
+  return allocateSlow(size, align);
+}
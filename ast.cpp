@@ -0,0 +1,68 @@
+#include "ast.hpp"
+#include "type.hpp"
+
+#include <algorithm>
+#include <functional>
+
+ast_context::ast_context() { makeBasicTypes(); }
+
+ast_context::~ast_context() { releaseAll(); }
+
+// The basic types are made again so the context stays usable.
+void ast_context::clear() {
+  releaseAll();
+  makeBasicTypes();
+}
+
+void ast_context::releaseAll() {
+  m_ref_types.clear();
+  m_ptr_types.clear();
+  m_func_types.clear();
+  m_types.release();
+  m_exprs.release();
+  m_stmts.release();
+  m_decls.release();
+}
+
+void ast_context::makeBasicTypes() {
+  m_bool = make<bool_type>();
+  m_char = make<char_type>();
+  m_int = make<int_type>();
+  m_float = make<float_type>();
+}
+
+type *ast_context::getRefType(type *t) {
+  type *&ref = m_ref_types[t];
+  if (!ref)
+    ref = make<ref_type>(t);
+  return ref;
+}
+
+type *ast_context::getPtrType(type *t) {
+  type *&ptr = m_ptr_types[t];
+  if (!ptr)
+    ptr = make<ptr_type>(t);
+  return ptr;
+}
+
+// Since the parameter and return types are themselves unique, signatures
+// are hashed and compared by address.
+type *ast_context::getFuncType(array_ref<type *> params, type *ret) {
+  std::hash<const type *> hash;
+  std::size_t h = hash(ret);
+  for (type *p : params)
+    h = h * 31 + hash(p);
+
+  auto range = m_func_types.equal_range(h);
+  for (auto iter = range.first; iter != range.second; ++iter) {
+    func_type *f = iter->second;
+    array_ref<type *> ps = f->getParameterTypes();
+    if (f->getReturnType() == ret &&
+        std::equal(ps.begin(), ps.end(), params.begin(), params.end()))
+      return f;
+  }
+
+  func_type *f = makeTrailing<func_type, type *>(params.size(), params, ret);
+  m_func_types.emplace(h, f);
+  return f;
+}
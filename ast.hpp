@@ -1,4 +1,149 @@
-struct type;
-struct expression;
-struct statement;
-struct declaration;
+#pragma once
+
+//
+// The owner of an abstract syntax tree
+//
+// Every type, expression, statement and declaration of a compilation unit
+// is allocated from its ast_context, in an arena per kind of node so that
+// nodes of a kind are laid out together. Destroying the context frees the
+// whole tree at once. Node destructors are not run, so a node must not own
+// memory of its own.
+//
+// Types are unique within a context: there is one object for each
+// structural type, so two types are the same exactly when their addresses
+// are equal.
+//
+// Nodes with a variable number of children keep them in an array right
+// after the node, allocated with it by makeTrailing (see trailing_objects),
+// rather than in a std::vector of their own.
+//
+
+#include "arena.hpp"
+
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class type;
+class expression;
+class statement;
+class declaration;
+
+struct func_type;
+
+// A view of a contiguous array that does not own it
+template <typename T> class array_ref {
+public:
+  array_ref() : m_data(nullptr), m_size(0) {}
+  array_ref(const T *data, std::size_t size) : m_data(data), m_size(size) {}
+  array_ref(const std::vector<T> &v) : m_data(v.data()), m_size(v.size()) {}
+
+  const T *begin() const { return m_data; }
+  const T *end() const { return m_data + m_size; }
+
+  std::size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+
+  const T &operator[](std::size_t n) const { return m_data[n]; }
+
+private:
+  const T *m_data;
+  std::size_t m_size;
+};
+
+// A base for a node that is followed in memory by an array of T. The node
+// must be allocated by ast_context::makeTrailing, and nothing may derive
+// from it that adds members.
+template <typename Node, typename T> class trailing_objects {
+protected:
+  T *getTrailingObjects() {
+    return reinterpret_cast<T *>(static_cast<Node *>(this) + 1);
+  }
+  const T *getTrailingObjects() const {
+    return reinterpret_cast<const T *>(static_cast<const Node *>(this) + 1);
+  }
+
+  // Copies elems into the array
+  void initTrailingObjects(array_ref<T> elems) {
+    std::uninitialized_copy(elems.begin(), elems.end(), getTrailingObjects());
+  }
+};
+
+class ast_context {
+public:
+  ast_context();
+  ~ast_context();
+
+  ast_context(const ast_context &) = delete;
+  ast_context &operator=(const ast_context &) = delete;
+
+  template <typename T, typename... Args> T *make(Args &&...args);
+
+  // Makes a node with room for n trailing objects of type E after it
+  template <typename T, typename E, typename... Args>
+  T *makeTrailing(std::size_t n, Args &&...args);
+
+  // Frees every node, so the context can be reused for another unit.
+  void clear();
+
+  type *getBoolType() const { return m_bool; }
+  type *getCharType() const { return m_char; }
+  type *getIntType() const { return m_int; }
+  type *getFloatType() const { return m_float; }
+
+  // The unique reference, pointer and function types
+  type *getRefType(type *t);
+  type *getPtrType(type *t);
+  type *getFuncType(array_ref<type *> params, type *ret);
+
+private:
+  // Frees every node, leaving no basic types
+  void releaseAll();
+  void makeBasicTypes();
+  template <typename T> arena &getArena();
+
+  arena m_types;
+  arena m_exprs;
+  arena m_stmts;
+  arena m_decls;
+
+  type *m_bool;
+  type *m_char;
+  type *m_int;
+  type *m_float;
+
+  // The types made so far, by element type or, for functions, by a hash
+  // of the signature
+  std::unordered_map<const type *, type *> m_ref_types;
+  std::unordered_map<const type *, type *> m_ptr_types;
+  std::unordered_multimap<std::size_t, func_type *> m_func_types;
+};
+
+template <typename T, typename... Args>
+T *ast_context::make(Args &&...args) {
+  return getArena<T>().template make<T>(std::forward<Args>(args)...);
+}
+
+template <typename T, typename E, typename... Args>
+T *ast_context::makeTrailing(std::size_t n, Args &&...args) {
+  static_assert(alignof(E) <= alignof(T), "misaligned trailing objects");
+  static_assert(std::is_trivially_destructible<E>::value,
+                "trailing objects are not destroyed");
+  void *p = getArena<T>().allocate(sizeof(T) + n * sizeof(E), alignof(T));
+  return new (p) T(std::forward<Args>(args)...);
+}
+
+template <typename T> arena &ast_context::getArena() {
+  if constexpr (std::is_base_of<type, T>::value)
+    return m_types;
+  else if constexpr (std::is_base_of<expression, T>::value)
+    return m_exprs;
+  else if constexpr (std::is_base_of<statement, T>::value)
+    return m_stmts;
+  else {
+    static_assert(std::is_base_of<declaration, T>::value, "not an AST node");
+    return m_decls;
+  }
+}
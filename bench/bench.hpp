@@ -0,0 +1,126 @@
+#pragma once
+
+//
+// Helpers shared by the benchmarks
+//
+// Each benchmark is a standalone program, built from the front end's
+// sources with the command at the top of its file, run from this
+// directory. FRONT_END stands for those sources:
+//
+//   FRONT_END="../arena.cpp ../ast.cpp ../declaration.cpp ../diagnostic.cpp
+//     ../expression.cpp ../file.cpp ../flat_ast.cpp ../lexer.cpp
+//     ../location.cpp ../parallel_lex.cpp ../parser.cpp ../relex.cpp
+//     ../scope.cpp ../semantics.cpp ../skip.cpp ../stack.cpp
+//     ../statement.cpp ../stream.cpp ../symbol.cpp ../token.cpp
+//     ../token_buffer.cpp ../type.cpp"
+//
+// The benchmarks generate their own input, so their numbers do not depend
+// on files outside the tree. Times are the best of several runs.
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+#include <unistd.h>
+
+// The best time of several runs of f, in seconds
+template <typename F> double bestOf(int runs, F f) {
+  double best = 1e300;
+  for (int i = 0; i != runs; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+    if (d.count() < best)
+      best = d.count();
+  }
+  return best;
+}
+
+// Keeps a result from being optimized away
+template <typename T> void keep(const T &x) {
+  static volatile T sink;
+  sink = x;
+}
+
+// A file holding some text, removed when this is destroyed. The front end
+// reads its input from files, so generated input goes through one.
+class temp_file {
+public:
+  explicit temp_file(const std::string &text) {
+    char path[] = "/tmp/bench-XXXXXX";
+    int fd = ::mkstemp(path);
+    if (fd < 0)
+      throw std::runtime_error("cannot create a temporary file");
+    for (std::size_t n = 0; n != text.size();) {
+      ssize_t k = ::write(fd, text.data() + n, text.size() - n);
+      if (k < 0) {
+        ::close(fd);
+        throw std::runtime_error("cannot write a temporary file");
+      }
+      n += k;
+    }
+    ::close(fd);
+    m_path = path;
+  }
+  ~temp_file() { ::unlink(m_path.c_str()); }
+
+  temp_file(const temp_file &) = delete;
+  temp_file &operator=(const temp_file &) = delete;
+
+  const std::string &getPath() const { return m_path; }
+
+private:
+  std::string m_path;
+};
+
+// A program of n global variables, each initialized by an arithmetic
+// expression over the two before it
+inline std::string makeExpressionProgram(int n) {
+  static const char *const ops[] = {" + ", " - ", " * ", " / ", " % ",
+                                    " & ", " | ", " ^ ", " << ", " >> "};
+  std::string text = "var g0: int = 1;\nvar g1: int = 2;\n";
+  for (int i = 2; i < n; ++i) {
+    std::string a = "g" + std::to_string(i - 1);
+    std::string b = "g" + std::to_string(i - 2);
+    text += "var g" + std::to_string(i) + ": int = (" + a + ops[i % 10] +
+            std::to_string(i % 97 + 1) + ")" + ops[(i + 3) % 10] + "(" + b +
+            ops[(i + 7) % 10] + a + ")" + ops[(i + 1) % 10] + "-" + b +
+            ops[(i + 5) % 10] + "(" + std::to_string(i % 13 + 1) + ");\n";
+  }
+  return text;
+}
+
+// A program of n functions, each calling the two before it, so that type
+// checking is dominated by calls and references
+inline std::string makeCallProgram(int n) {
+  std::string text = "def f0(a: int, b: int) -> int { return a + b; }\n"
+                     "def f1(a: int, b: int) -> int { return a * b; }\n";
+  for (int i = 2; i < n; ++i) {
+    std::string a = "f" + std::to_string(i - 1);
+    std::string b = "f" + std::to_string(i - 2);
+    text += "def f" + std::to_string(i) +
+            "(a: int, b: int) -> int {\n"
+            "  var x: int = " + a + "(a, b) + " + b + "(b, a);\n"
+            "  var y: int = " + a + "(x, " + b + "(x, a));\n"
+            "  return " + b + "(x + y, " + a + "(y, b));\n"
+            "}\n";
+  }
+  return text;
+}
+
+// About the given number of bytes of commented, loosely indented code,
+// like the output of our generators
+inline std::string makeCommentedText(std::size_t bytes) {
+  std::string text;
+  for (unsigned i = 0; text.size() < bytes; ++i) {
+    text += "\n\n        # generated from rule " + std::to_string(i) +
+            " of the table; do not edit\n";
+    text += "    #\n\t\t\n";
+    text += "    var t" + std::to_string(i) + ": int = " +
+            std::to_string(i * 7 % 1000) + ";   # value\n";
+  }
+  return text;
+}
@@ -0,0 +1,90 @@
+//
+// The cost of checked downcasts, and of type checking a call-heavy program
+//
+//   g++ -std=c++17 -O2 -pthread -I.. cast_bench.cpp $FRONT_END
+//   ./a.out [functions]
+//
+// The first part does what semantics::onIdExpression does for each name:
+// turn a declaration into a typed_decl, here over a shuffled mix of every
+// kind of declaration, once with dyn_cast and once with dynamic_cast.
+// This file needs RTTI for the comparison; the front end does not.
+//
+// The second part parses a program of functions that call each other, so
+// that semantic analysis of references and calls dominates. To compare it
+// with the dynamic_cast version of the front end, build the same file at
+// the commit before isa/cast/dyn_cast were introduced.
+//
+
+#include "bench.hpp"
+
+#include "declaration.hpp"
+#include "file.hpp"
+#include "parser.hpp"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Many declarations of every kind but programs and functions, which
+// cannot be made without trailing objects, in a random order so that the
+// branch on the kind cannot be predicted
+std::vector<declaration *> makeDeclarations(ast_context &ast, std::size_t n) {
+  std::vector<declaration *> ds;
+  ds.reserve(n);
+  for (std::size_t i = 0; i != n; ++i) {
+    switch (i % 5) {
+    case 0: ds.push_back(ast.make<var_decl>(nullptr, nullptr)); break;
+    case 1: ds.push_back(ast.make<const_decl>(nullptr, nullptr)); break;
+    case 2: ds.push_back(ast.make<val_decl>(nullptr, nullptr)); break;
+    case 3: ds.push_back(ast.make<param_decl>(nullptr, nullptr)); break;
+    case 4: ds.push_back(ast.make<error_decl>()); break;
+    }
+  }
+  std::shuffle(ds.begin(), ds.end(), std::mt19937(42));
+  return ds;
+}
+
+template <typename F>
+std::size_t countTyped(const std::vector<declaration *> &ds, F conv) {
+  std::size_t n = 0;
+  for (declaration *d : ds)
+    if (conv(d))
+      ++n;
+  return n;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int functions = argc > 1 ? std::atoi(argv[1]) : 50000;
+
+  ast_context nodes;
+  std::vector<declaration *> ds = makeDeclarations(nodes, 4000000);
+  auto kind_conv = [](declaration *d) { return dyn_cast<typed_decl>(d); };
+  auto rtti_conv = [](declaration *d) {
+    return dynamic_cast<typed_decl *>(d);
+  };
+  if (countTyped(ds, kind_conv) != countTyped(ds, rtti_conv)) {
+    std::fprintf(stderr, "the conversions disagree\n");
+    return 1;
+  }
+  double tk = bestOf(10, [&] { keep(countTyped(ds, kind_conv)); });
+  double tr = bestOf(10, [&] { keep(countTyped(ds, rtti_conv)); });
+  std::printf("dyn_cast:      %6.2f ns/cast\n", tk * 1e9 / ds.size());
+  std::printf("dynamic_cast:  %6.2f ns/cast  %.2fx\n", tr * 1e9 / ds.size(),
+              tr / tk);
+
+  temp_file src(makeCallProgram(functions));
+  file f(src.getPath());
+  double t = bestOf(5, [&] {
+    symbol_table syms;
+    ast_context ast;
+    parser p(syms, ast, f);
+    keep(p.parseProgram());
+  });
+  std::printf("%zu bytes of calls\n", f.size());
+  std::printf("parse and check: %7.1f MB/s  %6.1f us/function\n",
+              f.size() / t / 1e6, t * 1e6 / functions);
+}
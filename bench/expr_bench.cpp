@@ -0,0 +1,37 @@
+//
+// Parse throughput on expression-dense code
+//
+//   g++ -std=c++17 -O2 -pthread -I.. expr_bench.cpp $FRONT_END
+//   ./a.out [globals]
+//
+// Parses a program whose global initializers are long expressions over
+// the arithmetic, bitwise and shift levels, so that the time goes to the
+// expression engine and to semantic analysis of its nodes. The parser
+// runs in prelex mode, and the time includes lexing. To compare with the
+// recursive-descent chain this replaced, build the same file at the
+// commit before the precedence-climbing parser.
+//
+
+#include "bench.hpp"
+
+#include "file.hpp"
+#include "parser.hpp"
+
+int main(int argc, char *argv[]) {
+  int globals = argc > 1 ? std::atoi(argv[1]) : 200000;
+  temp_file src(makeExpressionProgram(globals));
+  file f(src.getPath());
+
+  // Operands: one in each of the first two globals, six after that
+  std::size_t operands = 2 + 6 * std::size_t(globals - 2);
+
+  double t = bestOf(5, [&] {
+    symbol_table syms;
+    ast_context ast;
+    parser p(syms, ast, f, lex_mode::prelex);
+    keep(p.parseProgram());
+  });
+  std::printf("%zu bytes, %zu operands\n", f.size(), operands);
+  std::printf("parse: %7.1f MB/s  %6.1f ns/operand\n", f.size() / t / 1e6,
+              t * 1e9 / operands);
+}
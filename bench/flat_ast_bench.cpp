@@ -0,0 +1,209 @@
+//
+// Traversal throughput and bytes per node of the pointer and flat ASTs
+//
+//   g++ -std=c++17 -O2 -pthread -I.. flat_ast_bench.cpp $FRONT_END
+//
+// Parses a program of expression-heavy global definitions, lowers it, and
+// walks every expression of both forms the same way, summing the literal
+// values so that the walk cannot be optimized away. The pointer form's
+// size counts each node and its trailing children at its static size;
+// arena padding and block slack are not included, which favours it.
+//
+
+#include "bench.hpp"
+
+#include "file.hpp"
+#include "flat_ast.hpp"
+#include "parser.hpp"
+
+namespace {
+
+struct pointer_walk {
+  std::size_t nodes = 0;
+  std::size_t bytes = 0;
+  std::uint64_t sum = 0;
+
+  void visit(const expression *e) {
+    if (!e)
+      return;
+    ++nodes;
+    switch (e->getKind()) {
+    case expression::bool_kind:
+      bytes += sizeof(bool_expr);
+      sum += cast<bool_expr>(e)->val;
+      break;
+    case expression::int_kind:
+      bytes += sizeof(int_expr);
+      sum += cast<int_expr>(e)->val;
+      break;
+    case expression::float_kind:
+      bytes += sizeof(float_expr);
+      break;
+    case expression::id_kind:
+      bytes += sizeof(id_expr);
+      break;
+    case expression::uop_kind:
+      bytes += sizeof(uop_expr);
+      visit(cast<uop_expr>(e)->m_arg);
+      break;
+    case expression::bop_kind: {
+      auto *b = cast<bop_expr>(e);
+      bytes += sizeof(bop_expr);
+      visit(b->m_lhs);
+      visit(b->m_rhs);
+      break;
+    }
+    case expression::call_kind:
+    case expression::index_kind: {
+      auto *p = cast<postfix_expr>(e);
+      bytes += sizeof(call_expr) +
+               p->getArguments().size() * sizeof(expression *);
+      visit(p->m_base);
+      for (const expression *a : p->getArguments())
+        visit(a);
+      break;
+    }
+    case expression::cast_kind:
+      bytes += sizeof(cast_expr);
+      visit(cast<cast_expr>(e)->m_src);
+      break;
+    case expression::assign_kind: {
+      auto *a = cast<assign_expr>(e);
+      bytes += sizeof(assign_expr);
+      visit(a->m_lhs);
+      visit(a->m_rhs);
+      break;
+    }
+    case expression::cond_kind: {
+      auto *c = cast<cond_expr>(e);
+      bytes += sizeof(cond_expr);
+      visit(c->m_cond);
+      visit(c->m_true);
+      visit(c->m_false);
+      break;
+    }
+    case expression::conv_kind:
+      bytes += sizeof(conv_expr);
+      visit(cast<conv_expr>(e)->m_src);
+      break;
+    default:
+      bytes += sizeof(error_expr);
+      break;
+    }
+  }
+
+  void visitProgram(const declaration *prog) {
+    auto *p = cast<prog_decl>(prog);
+    bytes += sizeof(prog_decl) +
+             p->getDeclarations().size() * sizeof(declaration *);
+    for (const declaration *d : p->getDeclarations()) {
+      bytes += sizeof(var_decl);
+      if (auto *o = dyn_cast<obj_decl>(d))
+        visit(o->getInit());
+    }
+  }
+};
+
+struct flat_walk {
+  explicit flat_walk(const flat_ast &ast) : ast(ast) {}
+
+  const flat_ast &ast;
+  std::size_t nodes = 0;
+  std::uint64_t sum = 0;
+
+  void visit(flat_ref r) {
+    if (r == flat_none)
+      return;
+    ++nodes;
+    const flat_expr &x = ast.getExpr(r);
+    switch (x.kind) {
+    case expression::bool_kind:
+    case expression::int_kind:
+      sum += std::int32_t(x.data[0]);
+      break;
+    case expression::uop_kind:
+    case expression::cast_kind:
+    case expression::conv_kind:
+      visit(x.data[0]);
+      break;
+    case expression::bop_kind:
+    case expression::assign_kind:
+      visit(x.data[0]);
+      visit(x.data[1]);
+      break;
+    case expression::call_kind:
+    case expression::index_kind:
+      visit(x.data[0]);
+      for (flat_ref a : ast.getList(x.data[1]))
+        visit(a);
+      break;
+    case expression::cond_kind:
+      visit(x.data[0]);
+      visit(ast.getExtra(x.data[1]));
+      visit(ast.getExtra(x.data[1] + 1));
+      break;
+    default:
+      break;
+    }
+  }
+
+  void visitProgram() {
+    const flat_decl &prog = ast.getDecl(ast.getProgram());
+    for (flat_ref d : ast.getList(prog.data[0])) {
+      const flat_decl &x = ast.getDecl(d);
+      if (x.kind != declaration::func_kind &&
+          x.kind != declaration::error_kind)
+        visit(x.data[0]);
+    }
+  }
+};
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int globals = argc > 1 ? std::atoi(argv[1]) : 200000;
+  temp_file src(makeExpressionProgram(globals));
+
+  file f(src.getPath());
+  symbol_table syms;
+  ast_context ast;
+  parser p(syms, ast, f, lex_mode::prelex);
+  declaration *prog = p.parseProgram();
+  if (!p.getDiagnostics().empty()) {
+    std::fprintf(stderr, "the generated program has errors\n");
+    return 1;
+  }
+
+  flat_ast flat;
+  double lower = bestOf(5, [&] { flat = flat_ast::lower(prog); });
+
+  pointer_walk pw;
+  pw.visitProgram(prog);
+  flat_walk fw(flat);
+  fw.visitProgram();
+  if (pw.nodes != fw.nodes || pw.sum != fw.sum) {
+    std::fprintf(stderr, "the walks disagree\n");
+    return 1;
+  }
+
+  double tp = bestOf(20, [&] {
+    pointer_walk w;
+    w.visitProgram(prog);
+    keep(w.sum);
+  });
+  double tf = bestOf(20, [&] {
+    flat_walk w(flat);
+    w.visitProgram();
+    keep(w.sum);
+  });
+
+  std::size_t nodes = pw.nodes;
+  std::size_t decls = flat.getNumDecls();
+  std::printf("%zu expressions, %zu declarations\n", nodes, decls);
+  std::printf("lowering: %.1f ms\n", lower * 1e3);
+  std::printf("pointer:  %6.2f ns/node  %6.1f bytes/node\n", tp * 1e9 / nodes,
+              double(pw.bytes) / (nodes + decls));
+  std::printf("flat:     %6.2f ns/node  %6.1f bytes/node\n", tf * 1e9 / nodes,
+              double(flat.getSize()) / (nodes + decls));
+  std::printf("speedup:  %.2fx\n", tp / tf);
+}
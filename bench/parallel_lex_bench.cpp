@@ -0,0 +1,54 @@
+//
+// Lexing throughput of lex_parallel by number of threads
+//
+//   g++ -std=c++17 -O2 -pthread -I.. parallel_lex_bench.cpp $FRONT_END
+//   ./a.out [threads] [megabytes]
+//
+// Lexes a generated file into a token buffer, first with one lexer on a
+// single-threaded symbol table, as the parser's prelex mode does, and
+// then with lex_parallel on 1, 2, 4... threads sharing a concurrent one.
+//
+
+#include "bench.hpp"
+
+#include "file.hpp"
+#include "lexer.hpp"
+#include "parallel_lex.hpp"
+
+#include <thread>
+
+int main(int argc, char *argv[]) {
+  unsigned max_threads = argc > 1 ? std::atoi(argv[1])
+                                  : std::thread::hardware_concurrency();
+  std::size_t mb = argc > 2 ? std::atol(argv[2]) : 64;
+  if (max_threads == 0)
+    max_threads = 1;
+
+  temp_file src(makeCommentedText(mb << 20));
+  file f(src.getPath());
+
+  std::size_t tokens = 0;
+  double base = bestOf(5, [&] {
+    symbol_table syms;
+    token_buffer buf(syms, f.getId(), f.begin());
+    lexer lex(syms, f);
+    while (token tok = lex.scan())
+      buf.push_back(tok);
+    tokens = buf.size();
+  });
+  std::printf("%zu bytes, %zu tokens\n", f.size(), tokens);
+  std::printf("sequential:     %7.1f MB/s\n", f.size() / base / 1e6);
+
+  for (unsigned n = 1; n <= max_threads; n *= 2) {
+    double t = bestOf(5, [&] {
+      symbol_table syms(symbol_table::concurrent);
+      token_buffer buf(syms, f.getId(), f.begin());
+      lex_parallel(syms, f, buf, n);
+      keep(buf.size());
+    });
+    std::printf("%2u threads:     %7.1f MB/s  %.2fx\n", n,
+                f.size() / t / 1e6, base / t);
+    if (n != max_threads && n * 2 > max_threads)
+      n = max_threads / 2;
+  }
+}
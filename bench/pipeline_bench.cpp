@@ -0,0 +1,69 @@
+//
+// End-to-end speedup of the pipelined mode on two cores
+//
+//   g++ -std=c++17 -O2 -pthread -I.. pipeline_bench.cpp $FRONT_END
+//   ./a.out [globals]
+//
+// The process is pinned to the first two CPUs it may run on, so that the
+// lexer thread and the parser share a two-core budget however many the
+// machine has. Each run parses a generated file from a fresh symbol table
+// and AST: in pull mode with a single-threaded table, as a one-core build
+// would, and in pipelined mode with the concurrent table it requires.
+//
+
+#include "bench.hpp"
+
+#include "file.hpp"
+#include "parser.hpp"
+
+#include <sched.h>
+
+namespace {
+
+// Restricts the process to two CPUs. Returns false if it has fewer.
+bool pinToTwoCores() {
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof allowed, &allowed) != 0)
+    return false;
+  cpu_set_t two;
+  CPU_ZERO(&two);
+  int n = 0;
+  for (int cpu = 0; cpu != CPU_SETSIZE && n != 2; ++cpu) {
+    if (CPU_ISSET(cpu, &allowed)) {
+      CPU_SET(cpu, &two);
+      ++n;
+    }
+  }
+  return n == 2 && sched_setaffinity(0, sizeof two, &two) == 0;
+}
+
+double parseTime(const file &f, lex_mode mode, symbol_table::mode sm) {
+  return bestOf(5, [&] {
+    symbol_table syms(sm);
+    ast_context ast;
+    parser p(syms, ast, f, mode);
+    keep(p.parseProgram());
+  });
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int globals = argc > 1 ? std::atoi(argv[1]) : 400000;
+  if (!pinToTwoCores()) {
+    std::fprintf(stderr, "needs at least two CPUs\n");
+    return 1;
+  }
+
+  temp_file src(makeExpressionProgram(globals));
+  file f(src.getPath());
+
+  double pull =
+      parseTime(f, lex_mode::pull, symbol_table::single_threaded);
+  double piped =
+      parseTime(f, lex_mode::pipelined, symbol_table::concurrent);
+  std::printf("%zu bytes on 2 cores\n", f.size());
+  std::printf("pull:       %7.1f MB/s\n", f.size() / pull / 1e6);
+  std::printf("pipelined:  %7.1f MB/s  %.2fx\n", f.size() / piped / 1e6,
+              pull / piped);
+}
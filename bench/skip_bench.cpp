@@ -0,0 +1,104 @@
+//
+// Bytes per second of skipping blanks and comments and of marking lines,
+// byte at a time and with skip.hpp
+//
+//   g++ -std=c++17 -O2 -I.. skip_bench.cpp ../skip.cpp
+//   ./a.out [megabytes]
+//
+// The trivia walk is the lexer's loop between tokens: skip blanks, skip a
+// comment to the end of its line, and step over anything else one word at
+// a time, the same way in both versions. The "before" functions are the
+// loops the lexer used before skip.hpp.
+//
+
+#include "bench.hpp"
+
+#include "skip.hpp"
+
+#include <vector>
+
+namespace {
+
+const char *skipBlanksBytewise(const char *first, const char *last) {
+  while (first != last && (*first == ' ' || *first == '\t' || *first == '\n'))
+    ++first;
+  return first;
+}
+
+const char *findNewlineBytewise(const char *first, const char *last) {
+  while (first != last && *first != '\n')
+    ++first;
+  return first;
+}
+
+void markNewlinesBytewise(const char *first, const char *last,
+                          std::uint32_t base,
+                          std::vector<std::uint32_t> &starts) {
+  for (const char *p = first; p != last; ++p)
+    if (*p == '\n')
+      starts.push_back(base + (p - first) + 1);
+}
+
+template <typename Skip, typename Find>
+std::size_t walkTrivia(const std::string &text, Skip skip, Find find) {
+  const char *p = text.data();
+  const char *last = p + text.size();
+  std::size_t words = 0;
+  while (true) {
+    p = skip(p, last);
+    if (p == last)
+      break;
+    if (*p == '#') {
+      p = find(p, last);
+      continue;
+    }
+    ++words;
+    while (p != last && *p != ' ' && *p != '\t' && *p != '\n')
+      ++p;
+  }
+  return words;
+}
+
+void report(const char *what, std::size_t bytes, double before,
+            double after) {
+  std::printf("%-14s before %7.0f MB/s  after %7.0f MB/s  %.2fx\n", what,
+              bytes / before / 1e6, bytes / after / 1e6, before / after);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::size_t mb = argc > 1 ? std::atol(argv[1]) : 64;
+  std::string text = makeCommentedText(mb << 20);
+
+  std::size_t w1 = walkTrivia(text, skipBlanksBytewise, findNewlineBytewise);
+  std::size_t w2 = walkTrivia(text, skip_blanks, find_newline);
+  if (w1 != w2) {
+    std::fprintf(stderr, "the walks disagree\n");
+    return 1;
+  }
+  double walk_before = bestOf(5, [&] {
+    keep(walkTrivia(text, skipBlanksBytewise, findNewlineBytewise));
+  });
+  double walk_after =
+      bestOf(5, [&] { keep(walkTrivia(text, skip_blanks, find_newline)); });
+
+  std::vector<std::uint32_t> starts;
+  starts.reserve(text.size() / 8);
+  const char *first = text.data();
+  const char *last = first + text.size();
+  double mark_before = bestOf(5, [&] {
+    starts.clear();
+    markNewlinesBytewise(first, last, 0, starts);
+    keep(starts.size());
+  });
+  double mark_after = bestOf(5, [&] {
+    starts.clear();
+    mark_newlines(first, last, 0, starts);
+    keep(starts.size());
+  });
+
+  std::printf("%zu bytes, %zu lines\n", text.size(), starts.size());
+  report("trivia walk", text.size(), walk_before, walk_after);
+  report("line table", text.size(), mark_before, mark_after);
+}
@@ -0,0 +1,84 @@
+//
+// Interning throughput of the symbol table from 1 to N threads
+//
+//   g++ -std=c++17 -O2 -pthread -I.. symbol_bench.cpp ../arena.cpp ../symbol.cpp
+//   ./a.out [threads] [names per thread]
+//
+// Each thread interns its own stream of spellings, drawn like a lexer's:
+// mostly repeats of names seen before, a quarter of them shared with the
+// other threads. The single-threaded table on one thread is the baseline;
+// a concurrent table should stay close to it there and scale with the
+// number of threads after that.
+//
+
+#include "bench.hpp"
+
+#include "symbol.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// The spellings interned by thread t, as a lexer would see them
+std::vector<std::string> makeNames(unsigned t, std::size_t n) {
+  std::vector<std::string> names;
+  names.reserve(n);
+  std::uint32_t x = 2463534242u + t;
+  for (std::size_t i = 0; i != n; ++i) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    if (x % 4 == 0)
+      names.push_back("shared_" + std::to_string(x % 4096));
+    else
+      names.push_back("t" + std::to_string(t) + "_" +
+                      std::to_string(x % (n / 8 + 1)));
+  }
+  return names;
+}
+
+double run(symbol_table::mode m,
+           const std::vector<std::vector<std::string>> &names) {
+  return bestOf(5, [&] {
+    symbol_table syms(m);
+    std::vector<std::thread> threads;
+    for (const auto &ns : names)
+      threads.emplace_back([&syms, &ns] {
+        std::uint32_t sum = 0;
+        for (const std::string &s : ns)
+          sum += syms.get(s).getId();
+        keep(sum);
+      });
+    for (std::thread &t : threads)
+      t.join();
+  });
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  unsigned max_threads = argc > 1 ? std::atoi(argv[1])
+                                  : std::thread::hardware_concurrency();
+  std::size_t per_thread = argc > 2 ? std::atol(argv[2]) : 1000000;
+  if (max_threads == 0)
+    max_threads = 1;
+
+  std::vector<std::vector<std::string>> names;
+  for (unsigned t = 0; t != max_threads; ++t)
+    names.push_back(makeNames(t, per_thread));
+
+  double base = run(symbol_table::single_threaded, {names[0]});
+  std::printf("single-threaded table, 1 thread: %6.1f Mnames/s\n",
+              per_thread / base / 1e6);
+  for (unsigned n = 1; n <= max_threads; n *= 2) {
+    std::vector<std::vector<std::string>> slice(names.begin(),
+                                                names.begin() + n);
+    double t = run(symbol_table::concurrent, slice);
+    std::printf("concurrent table, %2u threads:    %6.1f Mnames/s  %.2fx\n",
+                n, n * per_thread / t / 1e6, n * base / t);
+    if (n != max_threads && n * 2 > max_threads)
+      n = max_threads / 2;
+  }
+}
@@ -0,0 +1,65 @@
+//
+// Memory per token and parse throughput of the pull and pre-lexed modes
+//
+//   g++ -std=c++17 -O2 -pthread -I.. token_bench.cpp $FRONT_END
+//   ./a.out [globals]
+//
+// The pull model holds only a few tokens of lookahead, so its memory is
+// the size of a token; a pre-lexed file costs what its token buffer
+// allocates, which is compared with a plain vector of the same tokens.
+// Parse times include lexing and semantic analysis, and each mode starts
+// from a fresh symbol table and AST.
+//
+
+#include "bench.hpp"
+
+#include "file.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "token_buffer.hpp"
+
+#include <vector>
+
+namespace {
+
+double parseTime(const file &f, lex_mode mode) {
+  return bestOf(5, [&] {
+    symbol_table syms;
+    ast_context ast;
+    parser p(syms, ast, f, mode);
+    keep(p.parseProgram());
+  });
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int globals = argc > 1 ? std::atoi(argv[1]) : 200000;
+  temp_file src(makeExpressionProgram(globals));
+  file f(src.getPath());
+
+  symbol_table syms;
+  token_buffer buf(syms, f.getId(), f.begin());
+  std::vector<token> toks;
+  lexer lex(syms, f);
+  while (token tok = lex.scan()) {
+    buf.push_back(tok);
+    toks.push_back(tok);
+  }
+  toks.shrink_to_fit();
+
+  std::size_t n = buf.size();
+  std::printf("%zu bytes, %zu tokens\n", f.size(), n);
+  std::printf("sizeof(token):       %4zu bytes\n", sizeof(token));
+  std::printf("vector<token>:       %6.2f bytes/token\n",
+              double(toks.capacity() * sizeof(token)) / n);
+  std::printf("token_buffer:        %6.2f bytes/token\n",
+              double(buf.getCapacity()) / n);
+
+  double pull = parseTime(f, lex_mode::pull);
+  double prelex = parseTime(f, lex_mode::prelex);
+  std::printf("pull:    %7.1f MB/s  %6.1f ns/token\n", f.size() / pull / 1e6,
+              pull * 1e9 / n);
+  std::printf("prelex:  %7.1f MB/s  %6.1f ns/token  %.2fx\n",
+              f.size() / prelex / 1e6, prelex * 1e9 / n, pull / prelex);
+}
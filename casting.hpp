@@ -0,0 +1,42 @@
+#pragma once
+
+//
+// Checked conversions within the AST hierarchies
+//
+// Every type, expression, statement, declaration and scope carries a kind,
+// so a downcast can test it instead of using dynamic_cast and RTTI. A class
+// that can be the target of a conversion defines
+//
+//   static bool classof(const Base *x);
+//
+// which says whether x is an instance of it.
+//
+
+#include <cassert>
+
+// Whether x is an instance of To. x must not be null.
+template <typename To, typename From> inline bool isa(const From *x) {
+  assert(x && "isa<> on a null pointer");
+  return To::classof(x);
+}
+
+// Converts x to To, which it must be an instance of.
+template <typename To, typename From> inline To *cast(From *x) {
+  assert(isa<To>(x) && "cast<> to the wrong kind");
+  return static_cast<To *>(x);
+}
+
+template <typename To, typename From> inline const To *cast(const From *x) {
+  assert(isa<To>(x) && "cast<> to the wrong kind");
+  return static_cast<const To *>(x);
+}
+
+// Converts x to To if it is an instance of it, and returns null otherwise.
+template <typename To, typename From> inline To *dyn_cast(From *x) {
+  return isa<To>(x) ? static_cast<To *>(x) : nullptr;
+}
+
+template <typename To, typename From>
+inline const To *dyn_cast(const From *x) {
+  return isa<To>(x) ? static_cast<const To *>(x) : nullptr;
+}
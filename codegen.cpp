@@ -1,6 +1,7 @@
 #include "codegen.hpp"
 #include "declaration.hpp"
 #include "expression.hpp"
+#include "flat_ast.hpp"
 #include "statement.hpp"
 #include "type.hpp"
 
@@ -17,7 +18,8 @@
 #include <llvm\IR\Type.h>
 #include <llvm\Support\raw_ostream.h>
 
-using variable_map = std::unordered_map<const declaration * llvm::Value *>;
+// Variables by the index of their declaration in the flat AST
+using variable_map = std::unordered_map<flat_ref, llvm::Value *>;
 
 struct codegen_context {
   codegen_context() : ll(new llvm::LLVMContext()) {}
@@ -27,6 +29,7 @@ struct codegen_context {
   llvm::LLVMContext *getContext() const { return ll; }
 
   std::string getName(const declaration *d);
+  std::string getName(const flat_decl &d);
 
   llvm::Type *getType(const type *t);
   llvm::Type *getType(const typed_decl *d);
@@ -39,6 +42,8 @@ struct codegen_context {
   llvm::Type *getFuncType(const func_type *t);
 };
 
+// Function bodies are generated from the flat form of the program, which
+// is lowered once for the whole module.
 struct codegen_module {
   codegen_module(codegen_context &context, const prog_decl *program);
 
@@ -51,34 +56,43 @@ struct codegen_module {
   llvm::Module *module;
   llvm::Module *getModule() const { return module; }
 
-  void declare(const declaration *d, llvm::GlobalValue *v);
-  llvm::GlobalValue *lookup(const declaration *d) const;
+  const flat_ast &getFlat() const { return flat; }
+
+  void declare(flat_ref d, llvm::GlobalValue *v);
+  llvm::GlobalValue *lookup(flat_ref d) const;
 
   void generate();
-  void generate(const declaration *d);
-  void generateVarDecl(const var_decl *d);
-  void generateFuncDecl(consy func_decl *d);
+  void generate(flat_ref d);
+  void generateVarDecl(flat_ref d);
+  void generateFuncDecl(flat_ref d);
 
   const prog_decl *program;
+  flat_ast flat;
   variable_map globals;
 };
 
 codegen_function {
-  codegen_function(codegen_module & m, const func_decl *d);
+  codegen_function(codegen_module & m, flat_ref d);
 
   llvm::LLVMContext *getContext() const { return parent->getContext(); }
   llvm::Module *getModule() const { return parent->getModule(); }
   llvm::Function *getFunction() const { return func; }
 
-  std::string getName(const declaration *d) { return parent->getName(d); }
+  const flat_ast &getFlat() const { return parent->getFlat(); }
+
+  std::string getName(const flat_decl &d) { return parent->getName(d); }
 
   llvm::Type *getType(const type *t) { return parent->getType(t); }
-  llvm::Type *getType(const expression *e) { return getType(e->getType()); }
-  llvm::Type *getType(const typed_decl *t) { return parent->getType(t); }
+  llvm::Type *getType(const flat_expr &e) {
+    return getType(getFlat().getType(e.type));
+  }
+  llvm::Type *getType(const flat_decl &d) {
+    return getType(getFlat().getType(d.type));
+  }
 
-  void declare(const declaration *x, llvm::Value *v);
+  void declare(flat_ref d, llvm::Value *v);
 
-  llvm::Value *lookup(const declaration *x) const;
+  llvm::Value *lookup(flat_ref d) const;
 
   void define();
 
@@ -88,57 +102,57 @@ codegen_function {
 
   void emitBlock(llvm::BasicBlock * bb);
 
-  llvm::Value *generateExpr(const expression *e);
-  llvm::Value *generateBoolExpr(const bool_expr *e);
-  llvm::Value *generateIntExpr(const int_expr *e);
-  llvm::Value *generateFloatExpr(const float_expr *e);
-  llvm::Value *generateIdExpr(const id_expr *e);
-
-  llvm::Value *generateUopExpr(const uop_expr *e);
-  llvm::Value *generateArithmeticExpr(const uop_expr *e);
-  llvm::Value *generateIntExpr(const uop_expr *e);
-  llvm::Value *generateFloatExpr(const uop_expr *e);
-  llvm::Value *generateBitwiseExpr(const uop_expr *e);
-  llvm::Value *generateLogicalExpr(const uop_expr *e);
-  llvm::Value *generateAddressExpr(const uop_expr *e);
-  llvm::Value *generateDerefExpr(const uop_expr *e);
-
-  llvm::Value *generateBopExpr(const bop_expr *e);
-  llvm::Value *generateArithmeticExpr(const bop_expr *e);
-  llvm::Value *generateIntExpr(const bop_expr *e);
-  llvm::Value *generateFloatExpr(const bop_expr *e);
-  llvm::Value *generateBitwiseExpr(const bop_expr *e);
-  llvm::Value *generateLogicalExpr(const bop_expr *e);
-  llvm::Value *generateAndExpr(const bop_expr *e);
-  llvm::Value *generateOrExpr(const bop_expr *e);
-  llvm::Value *generateRelationalExpr(const bop_expr *e);
-
-  llvm::Value *generateCallExpr(const call_expr *e);
-  llvm::Value *generateIndexExpr(const index_expr *e);
-  llvm::Value *generateCastExpr(const cast_expr *e);
-  llvm::Value *generateCondExpr(const cond_expr *e);
-  llvm::Value *generateAssignExpr(const cond_expr *e);
-  llvm::Value *generateConvExpr(const conv_expr *e);
-
-  void generateStmt(const statement *s);
-  void generateBlockStmt(const block_stmt *s);
-  void generateWhenStmt(const when_stmt *s);
-  void generateIfStmt(const if_stmt *s);
-  void generateWhileStmt(const while_stmt *s);
-  void generateBreakStmt(const break_stmt *s);
-  void generateContStmt(const cont_stmt *s);
-  void generateRetStmt(const ret_stmt *s);
-  void generateDeclStmt(const decl_stmt *s);
-  void generateExprStmt(const expr_stmt *s);
-
-  void generateDecl(const declaration *d);
-  void generateVarDecl(const var_decl *d);
-
-  void makeVariable(const var_decl *d);
-  void makeReference(const var_decl *d);
+  llvm::Value *generateExpr(flat_ref e);
+  llvm::Value *generateBoolExpr(const flat_expr &e);
+  llvm::Value *generateIntExpr(const flat_expr &e);
+  llvm::Value *generateFloatExpr(const flat_expr &e);
+  llvm::Value *generateIdExpr(const flat_expr &e);
+
+  llvm::Value *generateUopExpr(const flat_expr &e);
+  llvm::Value *generateUnaryArithmeticExpr(const flat_expr &e);
+  llvm::Value *generateUnaryIntExpr(const flat_expr &e);
+  llvm::Value *generateUnaryFloatExpr(const flat_expr &e);
+  llvm::Value *generateUnaryBitwiseExpr(const flat_expr &e);
+  llvm::Value *generateUnaryLogicalExpr(const flat_expr &e);
+  llvm::Value *generateAddressExpr(const flat_expr &e);
+  llvm::Value *generateDerefExpr(const flat_expr &e);
+
+  llvm::Value *generateBopExpr(const flat_expr &e);
+  llvm::Value *generateBinaryArithmeticExpr(const flat_expr &e);
+  llvm::Value *generateBinaryIntExpr(const flat_expr &e);
+  llvm::Value *generateBinaryFloatExpr(const flat_expr &e);
+  llvm::Value *generateBinaryBitwiseExpr(const flat_expr &e);
+  llvm::Value *generateBinaryLogicalExpr(const flat_expr &e);
+  llvm::Value *generateAndExpr(const flat_expr &e);
+  llvm::Value *generateOrExpr(const flat_expr &e);
+  llvm::Value *generateRelationalExpr(const flat_expr &e);
+
+  llvm::Value *generateCallExpr(const flat_expr &e);
+  llvm::Value *generateIndexExpr(const flat_expr &e);
+  llvm::Value *generateCastExpr(const flat_expr &e);
+  llvm::Value *generateCondExpr(const flat_expr &e);
+  llvm::Value *generateAssignExpr(const flat_expr &e);
+  llvm::Value *generateConvExpr(const flat_expr &e);
+
+  void generateStmt(flat_ref s);
+  void generateBlockStmt(const flat_stmt &s);
+  void generateWhenStmt(const flat_stmt &s);
+  void generateIfStmt(const flat_stmt &s);
+  void generateWhileStmt(const flat_stmt &s);
+  void generateBreakStmt(const flat_stmt &s);
+  void generateContStmt(const flat_stmt &s);
+  void generateRetStmt(const flat_stmt &s);
+  void generateDeclStmt(const flat_stmt &s);
+  void generateExprStmt(const flat_stmt &s);
+
+  void generateDecl(flat_ref d);
+  void generateVarDecl(flat_ref d);
+
+  void makeVariable(flat_ref d);
+  void makeReference(flat_ref d);
 
   codegen_module *parent;
-  const func_decl *src;
+  flat_ref src;
   llvm::Function *func;
   llvm::BasicBlock *entry;
   llvm::BasicBlock *curr;
@@ -147,23 +161,28 @@ codegen_function {
 
 std::string codegen_context::getName(const declaration *d) {
   assert(d->getName());
-  return *d->getname();
+  return std::string(*d->getname());
+}
+
+std::string codegen_context::getName(const flat_decl &d) {
+  assert(d.name);
+  return std::string(*d.name);
 }
 
 llvm::Type *codegen_context::getType(const type *t) {
   switch (t->getKind()) {
   case type::bool_kind:
-    return getBoolType(static_cast<const bool_type *>(t));
+    return getBoolType(cast<bool_type>(t));
   case type::char_kind:
-    return getCharType(static_cast<const char_type *>(t));
+    return getCharType(cast<char_type>(t));
   case type::int_kind:
-    return getIntType(static_cast<const int_type *>(t));
+    return getIntType(cast<int_type>(t));
   case type::float_kind:
-    return getFloatType(static_cast<const float_type *>(t));
+    return getFloatType(cast<float_type>(t));
   case type::ref_kind:
-    return getRefType(static_cast<const ref_type *>(t));
+    return getRefType(cast<ref_type>(t));
   case type::func_kind:
-    return getFuncType(static_cast<const func_type *>(t));
+    return getFuncType(cast<func_type>(t));
   default:
     throw std::logic_error("Invalid Type");
   }
@@ -191,7 +210,7 @@ llvm::Type *codegen_context::getRefType(const ref_type *t) {
 }
 
 llvm::Type *codegen_context::getFuncType(const func_type *t) {
-  const type_list &ps = t->getParameterTypes();
+  array_ref<type *> ps = t->getParameterTypes();
   std::vector<llvm::Type *> params(ps.size());
   std::transform(ps.begin(), ps.end(), params.begin(),
                  [this](const type *p) { return getType(p); });
@@ -206,15 +225,15 @@ llvm::Type *codegen_context::getType(const typed_decl *d) {
 
 codegen_module::codegen_module(codegen_context &context,
                                const prog_decl *program)
-    : parent(&context), program(program),
+    : parent(&context), program(program), flat(flat_ast::lower(program)),
       mod(new llvm::Module("a.ll", *getContext())) {}
 
-void codegen_module::declare(const declaration *d, llvm::GlobalValue *v) {
+void codegen_module::declare(flat_ref d, llvm::GlobalValue *v) {
   assert(globals.count(d) == 0);
   globals.emplace(d, v);
 }
 
-llvm::GlobalValue *codegen_module::lookup(const declaration *d) const {
+llvm::GlobalValue *codegen_module::lookup(flat_ref d) const {
   auto iter = globals.find(d);
   if (iter != globals.end())
     return llvm::cast<llvm::GlobalValue>(iter->second);
@@ -223,31 +242,33 @@ llvm::GlobalValue *codegen_module::lookup(const declaration *d) const {
 }
 
 void codegen_module::generate() {
-  for (const declaration *d : program->getDeclarations())
+  const flat_decl &prog = flat.getDecl(flat.getProgram());
+  for (flat_ref d : flat.getList(prog.data[0]))
     generate(d);
 }
 
-void codegen_module::generate(const declaration *d) {
-  switch (d->getKind()) {
+void codegen_module::generate(flat_ref d) {
+  switch (flat.getDecl(d).kind) {
   case declaration::var_kind:
-    return generateVarDecl(static_cast<const var_decl *>(d));
+    return generateVarDecl(d);
   case declaration::func_kind:
-    return generateFuncDecl(static_cast<const func_decl *>(d));
-  case default:
+    return generateFuncDecl(d);
+  default:
     throw std::logic_error("Invalid declaration");
   }
 }
 
-void codegen_module::generateVarDecl(const var_decl *d) {
-  std::string n = getName(d);
-  llvm::Type *t = getType(d->getType());
+void codegen_module::generateVarDecl(flat_ref d) {
+  const flat_decl &x = flat.getDecl(d);
+  std::string n = parent->getName(x);
+  llvm::Type *t = getType(flat.getType(x.type));
   llvm::Constant *c = llvm::Constant::getNullValue(t);
   llvm::GlobalVariable *var = new llvm::GlobalVariable(
       *mod, t, false, llvm::GlobalVariable::ExternalLinkage, c, n);
   declare(d, var);
 }
 
-void codegen_module::generateFuncDecl(const func_decl *d) {
+void codegen_module::generateFuncDecl(flat_ref d) {
   codegen_function func(*this, d);
   func.define();
 }
@@ -257,10 +278,11 @@ static llvm::FunctionType *getFuncType(llvm::Type *t) {
   return llvm::cast<llvm::FunctionType>(t->getPointerElementType());
 }
 
-codegen_function::codegen_function(codegen_module &m, const func_decl *d)
+codegen_function::codegen_function(codegen_module &m, flat_ref d)
     : parent(&m), src(d), func(), entry(), curr() {
-  std::string n = getName(d);
-  llvm::Type *t = getType(d);
+  const flat_decl &x = getFlat().getDecl(d);
+  std::string n = getName(x);
+  llvm::Type *t = getType(x);
   func = llvm::Function::Create(getFuncType(t), llvm::Function::ExternalLinkage,
                                 n, getModule());
 
@@ -271,13 +293,14 @@ codegen_function::codegen_function(codegen_module &m, const func_decl *d)
 
   llvm::IRBuilder<> ir(getCurrentBlock());
 
-  assert(d->getParameters().size() == func->arg_size());
-  auto pi = d->getParameters().begin();
+  flat_list params = getFlat().getList(x.data[0]);
+  assert(params.size == func->arg_size());
+  auto pi = params.begin();
   auto ai = func->arg_begin();
   while (ai != func->arg_end()) {
-    const param_decl *param = static_cast<const param_decl *>(*pi);
+    flat_ref param = *pi;
     llvm::Argument &arg = *ai;
-    arg.setName(getName(param));
+    arg.setName(getName(getFlat().getDecl(param)));
     llvm::Value *var = ir.createAlloca(arg.getType(), nullptr, arg.getName());
 
     declare(param, var);
@@ -288,12 +311,12 @@ codegen_function::codegen_function(codegen_module &m, const func_decl *d)
   }
 }
 
-void codegen_function::declare(const declaration *d, llvm::Value *v) {
+void codegen_function::declare(flat_ref d, llvm::Value *v) {
   assert(locals.count(d) == 0);
   locals.emplace(d, v);
 }
 
-llvm::Value *codegen_function::lookup(const declaration *d) const {
+llvm::Value *codegen_function::lookup(flat_ref d) const {
   auto iter = locals.find(d);
   if (iter != locals.end())
     return iter->second;
@@ -310,98 +333,124 @@ void codegen_function::emitBlock(llvm::BasicBlock *bb) {
   curr = bb;
 }
 
-void codegen_function::define() { generateStmt(stc->getbody()); }
+void codegen_function::define() {
+  generateStmt(getFlat().getDecl(src).data[1]);
+}
 
-llvm::Value *codegen_function::generateExpr(const expression *e) {
-  switch (e->getKind()) {
+llvm::Value *codegen_function::generateExpr(flat_ref r) {
+  const flat_expr &e = getFlat().getExpr(r);
+  switch (e.kind) {
   case expression::bool_kind:
-    return generateBoolExpr(static_cast<const bool_expr *>(e));
+    return generateBoolExpr(e);
   case expression::int_kind:
-    return generateIntExpr(static_cast<const int_expr *>(e));
-  case expression::floatKind:
-    return generateFloatExpr(static_cast<const float_expr *>(e));
+    return generateIntExpr(e);
+  case expression::float_kind:
+    return generateFloatExpr(e);
   case expression::id_kind:
-    return generateIdExpr(static_cast<const id_expr *>(e));
+    return generateIdExpr(e);
   case expression::uop_kind:
-    return generateUopExpr(static_cast<const uop_expr *>(e));
+    return generateUopExpr(e);
   case expression::bop_kind:
-    return generateBopExpr(static_cast<const bop_expr *>(e));
+    return generateBopExpr(e);
   case expression::call_kind:
-    return generateCallExpr(static_cast<const call_expr *>(e));
+    return generateCallExpr(e);
   case expression::index_kind:
-    return generateIndexExpr(static_cast<const index_expr *>(e));
+    return generateIndexExpr(e);
+  case expression::cast_kind:
+    return generateCastExpr(e);
   case expression::cond_kind:
-    return generateCondExpr(static_cast<const cond_expr *>(e));
+    return generateCondExpr(e);
   case expression::assign_kind:
-    return generateAssignExpr(static_cast<const assign_expr *>(e));
+    return generateAssignExpr(e);
   case expression::conv_kind:
-    return generateConvExpr(static_cast<const conv_expr *>(e));
+    return generateConvExpr(e);
   default:
     throw std::runtime_error("Invalid Expression");
   }
 }
 
-llvm::Value *codegen_function::generateBoolExpr(const bool_expr *e) {
-  return llvm::ConstantInt::get(getType(e), e->getValue(), false);
+llvm::Value *codegen_function::generateBoolExpr(const flat_expr &e) {
+  return llvm::ConstantInt::get(getType(e), e.data[0], false);
+}
+
+llvm::Value *codegen_function::generateIntExpr(const flat_expr &e) {
+  return llvm::ConstantInt::get(getType(e), std::int32_t(e.data[0]), true);
 }
 
-llvm::Value *codegen_function::generateIntExpr(const int_expr *e) {
-  return llvm::ConstantInt::get(getType(e), e->getValue(), true);
+llvm::Value *codegen_function::generateFloatExpr(const flat_expr &e) {
+  return llvm::ConstantFP::get(getType(e), getFlat().getFloat(e.data[0]));
 }
 
-llvm::Value *codegen_function::generateFloatExpr(const float_expr *e) {
-  return llvm::ConstantFP::get(getType(e), e->getValue());
+llvm::Value *codegen_function::generateIdExpr(const flat_expr &e) {
+  return nullptr;
 }
 
-llvm::Value *codegen_function::generateIdExpr(const id_expr *e) {
+llvm::Value *codegen_function::generateUopExpr(const flat_expr &e) {
   return nullptr;
 }
 
-llvm::Value *codegen_function::generateUopExpr(const uop_expr *e) {
+llvm::Value *codegen_function::generateAddressExpr(const flat_expr &e) {
   return nullptr;
 }
 
-llvm::Value *codegen_function::generateAddressExpr(const uop_expr *e) {
+llvm::Value *codegen_function::generateDerefExpr(const flat_expr &e) {
   return nullptr;
 }
 
-llvm::Value *codegen_function::generateDerefExpr(const uop_expr *e) {
+llvm::Value *codegen_function::generateBopExpr(const flat_expr &e) {
   return nullptr;
 }
 
-llvm::Value *codegen_function::generateBopExpr(const bop_expr *e) {
+llvm::Value *codegen_function::generateRelationalExpr(const flat_expr &e) {
   return nullptr;
 }
 
-llvm::Value *codegen_function::generateRelationalExpr(const bop_expr *e) {
+llvm::Value *codegen_function::generateCallExpr(const flat_expr &e) {
   return nullptr;
 }
 
-llvm::Value *codegen_function::generateCallExpr(const call_expr *e) {
+llvm::Value *codegen_function::generateIndexExpr(const flat_expr &e) {
   return nullptr;
 }
 
-llvm::Value *codegen_function::generateIndexExpr(const index_expr *e) {
+llvm::Value *codegen_function::generateCastExpr(const flat_expr &e) {
   return nullptr;
 }
 
-llvm::Value *codegen_function::generateAssignExpr(const assign_expr *e) {
+llvm::Value *codegen_function::generateAssignExpr(const flat_expr &e) {
   return nullptr;
 }
 
-llvm::Value *codegen_function::generateCondExpr(const cond_expr *e) {
+llvm::Value *codegen_function::generateCondExpr(const flat_expr &e) {
   return nullptr;
 }
 
-llvm::Value *codegen_function::generateConvExpr(const conv_expr *c) {
+llvm::Value *codegen_function::generateConvExpr(const flat_expr &e) {
   return nullptr;
 }
 
-void codegen_function::generateStmt(const statement *s) {
-  switch (s->getKind()) {
+void codegen_function::generateStmt(flat_ref r) {
+  const flat_stmt &s = getFlat().getStmt(r);
+  switch (s.kind) {
   case statement::block_kind:
-    return generateBlockStmt(static_cast<const block_stmt *>(s));
+    return generateBlockStmt(s);
   case statement::when_kind:
-    return generateWhenStmt(static_cast)
+    return generateWhenStmt(s);
+  case statement::if_kind:
+    return generateIfStmt(s);
+  case statement::while_kind:
+    return generateWhileStmt(s);
+  case statement::break_kind:
+    return generateBreakStmt(s);
+  case statement::cont_kind:
+    return generateContStmt(s);
+  case statement::ret_kind:
+    return generateRetStmt(s);
+  case statement::decl_kind:
+    return generateDeclStmt(s);
+  case statement::expr_kind:
+    return generateExprStmt(s);
+  default:
+    throw std::runtime_error("Invalid Statement");
   }
 }
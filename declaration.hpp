@@ -1,3 +1,7 @@
+#pragma once
+
+#include "ast.hpp"
+#include "casting.hpp"
 #include "symbol.hpp"
 
 #include <vector>
@@ -19,7 +23,8 @@ public:
     const_kind,
     val_kind,
     param_kind,
-    funct_kind
+    func_kind,
+    error_kind
   };
 
   virtual ~declaration() = default;
@@ -40,18 +45,29 @@ protected:
 
 using decl_list = std::vector<decl *>;
 
-struct prog_decl : declaration {
-  prog_decl(const decl_list &ds)
-      : declaration(prog_kind, nullptr), m_decls(ds) {}
-  const decl_list &getDeclarations() const { return m_decls; }
-  decl_list &getDeclarations() { return m_decls; }
+// The declarations follow the node (see trailing_objects).
+struct prog_decl : declaration, trailing_objects<prog_decl, declaration *> {
+  prog_decl(array_ref<declaration *> ds)
+      : declaration(prog_kind, nullptr), m_num_decls(ds.size()) {
+    initTrailingObjects(ds);
+  }
+
+  array_ref<declaration *> getDeclarations() const {
+    return {getTrailingObjects(), m_num_decls};
+  }
 
-  decl_list m_decls;
+  std::uint32_t m_num_decls;
+
+  static bool classof(const declaration *d) {
+    return d->getKind() == prog_kind;
+  }
 };
 
 struct var_decl : obj_decl {
   var_decl(symbol sym, type *t, expression *e = nullptr)
       : obj_decl(var_kind, sym, t, e) {}
+
+  static bool classof(const declaration *d) { return d->getKind() == var_kind; }
 };
 
 struct typed_decl : declaration {
@@ -59,6 +75,10 @@ public:
   type *getType() const { return m_type; }
   void setType(type *t) { m_type = t; }
 
+  static bool classof(const declaration *d) {
+    return d->getKind() >= var_kind && d->getKind() <= func_kind;
+  }
+
 protected:
   typed_decl(kind k, symbol sym, type *t) : declaration(k, sym), m_type(t) {}
   type *m_type;
@@ -70,6 +90,10 @@ public:
   expression *getInit() const { return m_init; }
   void setInit(expression *e) { m_init = e; }
 
+  static bool classof(const declaration *d) {
+    return d->getKind() >= var_kind && d->getKind() <= param_kind;
+  }
+
 protected:
   obj_decl(kind k, symbol sym, type *t, expression *e)
       : typed_decl(k, sym, t), m_init(e) {}
@@ -79,30 +103,59 @@ protected:
 struct const_decl : obj_decl {
   const_decl(symbol symb, type *t, expression *e = nullptr)
       : object_devl(const_kind, sym, t, e) {}
+
+  static bool classof(const declaration *d) {
+    return d->getKind() == const_kind;
+  }
 };
 
 struct val_decl : obj_decl {
   val_decl(symbol sym, type *t, expression *e = nullptr)
       : obj_decl(val_kind, sym, t, e) {}
+
+  static bool classof(const declaration *d) { return d->getKind() == val_kind; }
 };
 
 struct param_decl : obj_decl {
   param_decl(symbol sym, type *t) : obj_decl(param_kind, sym, t, nullptr) {}
+
+  static bool classof(const declaration *d) {
+    return d->getKind() == param_kind;
+  }
 };
 
-struct func_decl : typed_decl {
-  func_decl(symbol sym, type *t, const decl_list &params, statment *s = nullptr)
-      : type_decl(func_kind, sym, t), m_params(params), m_body(s) {}
+// The parameters follow the node (see trailing_objects).
+struct func_decl : typed_decl, trailing_objects<func_decl, declaration *> {
+  func_decl(symbol sym, type *t, array_ref<declaration *> params,
+            statement *s = nullptr)
+      : typed_decl(func_kind, sym, t), m_num_params(params.size()),
+        m_body(s) {
+    initTrailingObjects(params);
+  }
 
-  const decl_list &getParameters() const { return m_params; }
+  array_ref<declaration *> getParameters() const {
+    return {getTrailingObjects(), m_num_params};
+  }
 
-  decl_list &getParameters() { return m_params; }
   func_type *getType() const;
   statement *getBody() const { return m_body; }
   type *getReturnType() const;
 
   void setBody(statement *s) { m_body = s; }
 
-  decl_list m_params;
+  std::uint32_t m_num_params;
   statement *m_body;
+
+  static bool classof(const declaration *d) {
+    return d->getKind() == func_kind;
+  }
+};
+
+// Stands in for a declaration with a syntax error
+struct error_decl : declaration {
+  error_decl() : declaration(error_kind, nullptr) {}
+
+  static bool classof(const declaration *d) {
+    return d->getKind() == error_kind;
+  }
 };
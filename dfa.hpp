@@ -0,0 +1,267 @@
+#pragma once
+
+//
+// Tables for the lexer's DFA
+//
+// The character classes and the transition table are computed at compile
+// time. Operators and punctuators are entered from the spellings in
+// fixed_tokens; words and numbers use the hand-written states below.
+//
+
+#include "token.hpp"
+
+#include <initializer_list>
+
+// What the lexer does when the DFA stops in a state
+enum lex_action : unsigned char {
+  act_none,
+  act_end,
+  act_blank,
+  act_comment,
+  act_character,
+  act_string,
+  act_error,
+  act_punctuator,
+  act_relational_op,
+  act_arithmetic_op,
+  act_bitwise_op,
+  act_assignment_op,
+  act_conditional_op,
+  act_word,
+  act_decimal,
+  act_floating_point,
+  act_binary,
+  act_hexadecimal,
+};
+
+// Tokens with a fixed spelling, and the attribute each one carries
+struct fixed_token {
+  const char* spelling;
+  lex_action action;
+  unsigned char attr;
+};
+
+constexpr fixed_token fixed_tokens[] = {
+  // Punctuators
+  { "(",  act_punctuator,     tok_left_paren },
+  { ")",  act_punctuator,     tok_right_paren },
+  { "[",  act_punctuator,     tok_left_bracket },
+  { "]",  act_punctuator,     tok_right_bracket },
+  { "{",  act_punctuator,     tok_left_brace },
+  { "}",  act_punctuator,     tok_right_brace },
+  { ",",  act_punctuator,     tok_comma },
+  { ";",  act_punctuator,     tok_semicolon },
+  { ":",  act_punctuator,     tok_colon },
+
+  // Operators
+  { "<",  act_relational_op,  op_lt },
+  { "<=", act_relational_op,  op_le },
+  { ">",  act_relational_op,  op_gt },
+  { ">=", act_relational_op,  op_ge },
+  { "==", act_relational_op,  op_eq },
+  { "<<", act_bitwise_op,     op_shl },
+  { ">>", act_bitwise_op,     op_shr },
+  { "&",  act_bitwise_op,     op_and },
+  { "|",  act_bitwise_op,     op_ior },
+  { "^",  act_bitwise_op,     op_xor },
+  { "~",  act_bitwise_op,     op_not },
+  { "+",  act_arithmetic_op,  op_add },
+  { "-",  act_arithmetic_op,  op_sub },
+  { "*",  act_arithmetic_op,  op_mul },
+  { "/",  act_arithmetic_op,  op_quo },
+  { "%",  act_arithmetic_op,  op_rem },
+  { "=",  act_assignment_op,  0 },
+  { "?",  act_conditional_op, 0 },
+};
+
+// Character classes. Every character of a fixed token that is not listed
+// here gets a class of its own.
+enum char_class : unsigned char {
+  cc_other,
+  cc_nul,
+  cc_blank,     // space, tab, newline
+  cc_hash,
+  cc_quote,
+  cc_dquote,
+  cc_zero,
+  cc_one,
+  cc_digit,     // 2-9
+  cc_b,         // b B: binary prefix, hex digit and letter
+  cc_x,         // x X: hex prefix and letter
+  cc_hex,       // the other hex digit letters
+  cc_alpha,     // the other letters
+  cc_under,
+  cc_dot,
+  cc_fixed,     // first class of a fixed token character
+};
+
+// States. 0 means "stop"; the state the DFA stops in decides the action.
+enum lex_state : unsigned char {
+  st_stop,
+  st_start,
+  st_blank,
+  st_comment,
+  st_character,
+  st_string,
+  st_error,
+  st_word,
+  st_zero,
+  st_decimal,
+  st_fraction,
+  st_binary,
+  st_hexadecimal,
+  st_fixed,     // first state of the fixed token trie
+};
+
+constexpr int dfa_max_classes = 48;
+constexpr int dfa_max_states = 64;
+
+// Classes and states are stored in unsigned chars
+static_assert(dfa_max_classes <= 256 && dfa_max_states <= 256,
+              "DFA classes and states must fit in a byte");
+
+template<int Classes, int States>
+struct basic_dfa_tables {
+  unsigned char cls[256];
+  unsigned char next[States][Classes];
+  lex_action action[States];
+  unsigned char attr[States];
+
+  // The number of classes and states in use
+  int classes;
+  int states;
+};
+
+using dfa_tables = basic_dfa_tables<dfa_max_classes, dfa_max_states>;
+
+template<typename Tables>
+constexpr void dfa_set(Tables& t, int from, int cls, int to) {
+  t.next[from][cls] = to;
+}
+
+// Every class that can continue a word. Note that '_' may start a word but
+// not continue one.
+constexpr char_class dfa_alnum[] = {
+  cc_zero, cc_one, cc_digit, cc_b, cc_x, cc_hex, cc_alpha
+};
+
+template<typename Tables>
+constexpr Tables make_dfa_tables() {
+  Tables t{};
+
+  // Character classes
+  t.cls[0] = cc_nul;
+  t.cls[' '] = t.cls['\t'] = t.cls['\n'] = cc_blank;
+  t.cls['#'] = cc_hash;
+  t.cls['\''] = cc_quote;
+  t.cls['"'] = cc_dquote;
+  t.cls['0'] = cc_zero;
+  t.cls['1'] = cc_one;
+  for (int c = '2'; c <= '9'; ++c)
+    t.cls[c] = cc_digit;
+  for (int c = 'a'; c <= 'z'; ++c)
+    t.cls[c] = t.cls[c - 'a' + 'A'] = cc_alpha;
+  for (int c = 'a'; c <= 'f'; ++c)
+    t.cls[c] = t.cls[c - 'a' + 'A'] = cc_hex;
+  t.cls['b'] = t.cls['B'] = cc_b;
+  t.cls['x'] = t.cls['X'] = cc_x;
+  t.cls['_'] = cc_under;
+  t.cls['.'] = cc_dot;
+
+  int classes = cc_fixed;
+  for (const fixed_token& tok : fixed_tokens)
+    for (const char* p = tok.spelling; *p; ++p)
+      if (t.cls[static_cast<unsigned char>(*p)] == cc_other)
+        t.cls[static_cast<unsigned char>(*p)] = classes++;
+
+  // Characters handled outside the DFA. A NUL is not consumed; it is
+  // either the sentinel or an invalid character.
+  t.action[st_start] = act_end;
+  for (int c = 0; c < classes; ++c)
+    dfa_set(t, st_start, c, st_error);
+  dfa_set(t, st_start, cc_nul, st_stop);
+  dfa_set(t, st_start, cc_blank, st_blank);
+  dfa_set(t, st_start, cc_hash, st_comment);
+  dfa_set(t, st_start, cc_quote, st_character);
+  dfa_set(t, st_start, cc_dquote, st_string);
+  t.action[st_blank] = act_blank;
+  t.action[st_comment] = act_comment;
+  t.action[st_character] = act_character;
+  t.action[st_string] = act_string;
+  t.action[st_error] = act_error;
+
+  // Words
+  dfa_set(t, st_start, cc_b, st_word);
+  dfa_set(t, st_start, cc_x, st_word);
+  dfa_set(t, st_start, cc_hex, st_word);
+  dfa_set(t, st_start, cc_alpha, st_word);
+  dfa_set(t, st_start, cc_under, st_word);
+  for (char_class c : dfa_alnum)
+    dfa_set(t, st_word, c, st_word);
+  t.action[st_word] = act_word;
+
+  // Numbers
+  dfa_set(t, st_start, cc_zero, st_zero);
+  dfa_set(t, st_start, cc_one, st_decimal);
+  dfa_set(t, st_start, cc_digit, st_decimal);
+  for (int c : {cc_zero, cc_one, cc_digit}) {
+    dfa_set(t, st_zero, c, st_decimal);
+    dfa_set(t, st_decimal, c, st_decimal);
+    dfa_set(t, st_fraction, c, st_fraction);
+  }
+  dfa_set(t, st_zero, cc_dot, st_fraction);
+  dfa_set(t, st_decimal, cc_dot, st_fraction);
+  dfa_set(t, st_zero, cc_b, st_binary);
+  dfa_set(t, st_zero, cc_x, st_hexadecimal);
+  dfa_set(t, st_binary, cc_zero, st_binary);
+  dfa_set(t, st_binary, cc_one, st_binary);
+  for (int c : {cc_zero, cc_one, cc_digit, cc_b, cc_hex})
+    dfa_set(t, st_hexadecimal, c, st_hexadecimal);
+  t.action[st_zero] = act_decimal;
+  t.action[st_decimal] = act_decimal;
+  t.action[st_fraction] = act_floating_point;
+  t.action[st_binary] = act_binary;
+  t.action[st_hexadecimal] = act_hexadecimal;
+
+  // Operators and punctuators, as a trie over their spellings
+  int states = st_fixed;
+  for (const fixed_token& tok : fixed_tokens) {
+    int s = st_start;
+    for (const char* p = tok.spelling; *p; ++p) {
+      int c = t.cls[static_cast<unsigned char>(*p)];
+      int n = t.next[s][c];
+      if (n == st_stop || n == st_error) {
+        n = states++;
+        dfa_set(t, s, c, n);
+      }
+      s = n;
+    }
+    t.action[s] = tok.action;
+    t.attr[s] = tok.attr;
+  }
+
+  t.classes = classes;
+  t.states = states;
+  return t;
+}
+
+// The tables are first built as large as they can be, only to count the
+// classes and states that the spellings need. Adding a fixed token that
+// outgrows the real tables then fails one of these assertions.
+struct dfa_size {
+  int classes;
+  int states;
+};
+
+constexpr dfa_size count_dfa() {
+  auto t = make_dfa_tables<basic_dfa_tables<256, 256>>();
+  return { t.classes, t.states };
+}
+
+constexpr dfa_size dfa_needed = count_dfa();
+static_assert(dfa_needed.classes <= dfa_max_classes,
+              "too many character classes for the DFA tables");
+static_assert(dfa_needed.states <= dfa_max_states,
+              "too many states for the DFA tables");
+
+inline constexpr dfa_tables dfa = make_dfa_tables<dfa_tables>();
@@ -0,0 +1,177 @@
+//
+// A compile-time check of the DFA tables against the old lexer
+//
+// Before the lexer was table-driven, scan() switched on the first
+// character and called a helper for each kind of token. old_scan below
+// transcribes how far that code went and what it returned, and the tables
+// in dfa.hpp must agree with it on every input of up to three characters
+// from a set that covers each character class, as well as on every byte
+// followed by each of those characters. Nothing here is linked into the
+// compiler; it only fails the build if the tables change behaviour.
+//
+// Characters, strings, blanks and comments are handed off by the DFA
+// after their first character, so only that dispatch is compared for them.
+//
+
+#include "dfa.hpp"
+
+namespace {
+
+// The token at the start of some text: what the lexer does with it, its
+// attribute, and how many characters it spans
+struct scan_result {
+  lex_action action;
+  unsigned char attr;
+  int length;
+
+  constexpr bool operator==(const scan_result& r) const {
+    return action == r.action && attr == r.attr && length == r.length;
+  }
+};
+
+constexpr scan_result dfa_scan(const char* first) {
+  const char* p = first;
+  unsigned state = st_start;
+  while (unsigned next = dfa.next[state][dfa.cls[(unsigned char)*p]]) {
+    state = next;
+    ++p;
+  }
+  return { dfa.action[state], dfa.attr[state], int(p - first) };
+}
+
+// The character tests of the old lexer, in the "C" locale
+constexpr bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+constexpr bool is_alpha(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+constexpr bool is_nondigit(char c) { return is_alpha(c) || c == '_'; }
+constexpr bool is_alphanumeric(char c) { return is_alpha(c) || is_digit(c); }
+constexpr bool is_binary_digit(char c) { return c == '0' || c == '1'; }
+
+constexpr bool is_hexadecimal_digit(char c) {
+  return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+constexpr scan_result old_number(const char* first) {
+  const char* p = first;
+  if (p[0] == '0' && (p[1] == 'b' || p[1] == 'B')) {
+    p += 2;
+    while (is_binary_digit(*p))
+      ++p;
+    return { act_binary, 0, int(p - first) };
+  }
+  if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+    p += 2;
+    while (is_hexadecimal_digit(*p))
+      ++p;
+    return { act_hexadecimal, 0, int(p - first) };
+  }
+
+  ++p;
+  while (is_digit(*p))
+    ++p;
+  if (*p != '.')
+    return { act_decimal, 0, int(p - first) };
+  ++p;
+  while (is_digit(*p))
+    ++p;
+  return { act_floating_point, 0, int(p - first) };
+}
+
+constexpr scan_result old_scan(const char* p) {
+  switch (*p) {
+    case '\0':  return { act_end, 0, 0 };
+
+    case ' ':
+    case '\t':
+    case '\n':  return { act_blank, 0, 1 };
+    case '#':   return { act_comment, 0, 1 };
+
+    case '(':   return { act_punctuator, tok_left_paren, 1 };
+    case ')':   return { act_punctuator, tok_right_paren, 1 };
+    case '[':   return { act_punctuator, tok_left_bracket, 1 };
+    case ']':   return { act_punctuator, tok_right_bracket, 1 };
+    case '{':   return { act_punctuator, tok_left_brace, 1 };
+    case '}':   return { act_punctuator, tok_right_brace, 1 };
+    case ',':   return { act_punctuator, tok_comma, 1 };
+    case ';':   return { act_punctuator, tok_semicolon, 1 };
+    case ':':   return { act_punctuator, tok_colon, 1 };
+
+    case '<':   if (p[1] == '=') return { act_relational_op, op_le, 2 };
+                if (p[1] == '<') return { act_bitwise_op, op_shl, 2 };
+                return { act_relational_op, op_lt, 1 };
+
+    case '>':   if (p[1] == '=') return { act_relational_op, op_ge, 2 };
+                if (p[1] == '>') return { act_bitwise_op, op_shr, 2 };
+                return { act_relational_op, op_gt, 1 };
+
+    case '=':   if (p[1] == '=') return { act_relational_op, op_eq, 2 };
+                return { act_assignment_op, 0, 1 };
+
+    case '+':   return { act_arithmetic_op, op_add, 1 };
+    case '-':   return { act_arithmetic_op, op_sub, 1 };
+    case '*':   return { act_arithmetic_op, op_mul, 1 };
+    case '/':   return { act_arithmetic_op, op_quo, 1 };
+    case '%':   return { act_arithmetic_op, op_rem, 1 };
+    case '&':   return { act_bitwise_op, op_and, 1 };
+    case '|':   return { act_bitwise_op, op_ior, 1 };
+    case '^':   return { act_bitwise_op, op_xor, 1 };
+    case '~':   return { act_bitwise_op, op_not, 1 };
+    case '?':   return { act_conditional_op, 0, 1 };
+    case '\'':  return { act_character, 0, 1 };
+    case '"':   return { act_string, 0, 1 };
+
+    default:
+      break;
+  }
+
+  if (is_nondigit(*p)) {
+    int n = 1;
+    while (is_alphanumeric(p[n]))
+      ++n;
+    return { act_word, 0, n };
+  }
+  if (is_digit(*p))
+    return old_number(p);
+  return { act_error, 0, 1 };
+}
+
+// One character of each class, and of each fixed token
+constexpr char samples[] =
+  " \t\n#'\"019bBxXaAfFgz_.()[]{},;:<>=+-*/%&|^~?$@\\`";
+
+constexpr bool agrees(const char* text) {
+  return dfa_scan(text) == old_scan(text);
+}
+
+constexpr bool check_short_inputs() {
+  constexpr int n = sizeof samples - 1;
+  for (int i = 0; i < n; ++i)
+    for (int j = 0; j < n; ++j)
+      for (int k = 0; k < n; ++k) {
+        char text[] = { samples[i], samples[j], samples[k], 0 };
+        if (!agrees(text))
+          return false;
+      }
+  return true;
+}
+
+constexpr bool check_every_byte() {
+  constexpr int n = sizeof samples - 1;
+  for (int c = 1; c < 256; ++c)
+    for (int j = 0; j < n; ++j) {
+      char text[] = { char(c), samples[j], 0 };
+      if (!agrees(text))
+        return false;
+    }
+  return agrees("");
+}
+
+static_assert(check_every_byte(),
+              "the DFA disagrees with the old lexer on a leading byte");
+static_assert(check_short_inputs(),
+              "the DFA disagrees with the old lexer on a short input");
+
+} // namespace
@@ -0,0 +1,11 @@
+#include "diagnostic.hpp"
+
+#include <iostream>
+
+std::ostream& operator<<(std::ostream& os, const diagnostic& d) {
+  if (const source* src = source::get(d.loc.source)) {
+    line_column lc = src->resolve(d.loc.offset);
+    os << src->getName() << ':' << lc.line << ':' << lc.column << ": ";
+  }
+  return os << "error: " << d.message;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+//
+// Diagnostics
+//
+// Errors that compilation can continue past are recorded rather than
+// thrown, so that one run reports all of them.
+//
+
+#include "location.hpp"
+
+#include <iosfwd>
+#include <string>
+
+struct diagnostic {
+  location loc;
+  std::string message;
+};
+
+// Prints "name:line:column: error: message".
+std::ostream& operator<<(std::ostream& os, const diagnostic& d);
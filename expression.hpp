@@ -1,3 +1,7 @@
+#pragma once
+
+#include "ast.hpp"
+#include "casting.hpp"
 #include "token.hpp"
 
 #include <vector>
@@ -22,7 +26,8 @@ public:
     cast_kind,
     assign_kind,
     cond_kind,
-    conv_kind
+    conv_kind,
+    error_kind
   };
 
   virtual ~expression() = default;
@@ -52,6 +57,8 @@ struct bool_expr : expression {
   bool_expr(type *t, bool b) : expression(bool_kind, t), val(b) {}
   bool getValue() const { return val; }
   bool val;
+
+  static bool classof(const expression *e) { return e->getKind() == bool_kind; }
 };
 
 struct int_expr : expression {
@@ -59,18 +66,26 @@ struct int_expr : expression {
     bool getValue() const { return val; }
     int val;
   }
+
+  static bool classof(const expression *e) { return e->getKind() == int_kind; }
 };
 
 struct float_expr : expression {
   float_expr(type *t double n) : expression(float_kind, t), val(n) {}
   bool getValue() const { return val; }
   double val;
+
+  static bool classof(const expression *e) {
+    return e->getKind() == float_kind;
+  }
 };
 
 struct id_expr : expression {
   id_expr(type *t, declaration *d) : expr(id_kind, t), ref(d) {}
   declaration *getDeclaration() const { return ref; }
   declaration *ref;
+
+  static bool classof(const expression *e) { return e->getKind() == id_kind; }
 }
 
 enum uop {
@@ -89,6 +104,8 @@ struct uop_expr : expression {
 
   uop m_op;
   expression *m_arg;
+
+  static bool classof(const expression *e) { return e->getKind() == uop_kind; }
 };
 
 enum bop {
@@ -124,37 +141,60 @@ struct bop_expr : expression {
   bop m_op;
   expression *m_lhs;
   expression *m_rhs;
+
+  static bool classof(const expression *e) { return e->getKind() == bop_kind; }
 };
 
-struct postfirx_expr : expression {
-  postfix_expr(kind k, type *t, expression *e, const expr_list &args)
-      : expression(k), m_base(e), m_args(args) {}
+// The arguments follow the node (see trailing_objects).
+struct postfix_expr : expression,
+                      trailing_objects<postfix_expr, expression *> {
+  postfix_expr(kind k, type *t, expression *e, array_ref<expression *> args)
+      : expression(k, t), m_base(e), m_num_args(args.size()) {
+    initTrailingObjects(args);
+  }
 
-  const expr_list &getArguments() const { return m_args; }
-  expr_list &getArguments() { return m_args; }
+  array_ref<expression *> getArguments() const {
+    return {getTrailingObjects(), m_num_args};
+  }
 
   expression *m_base;
-  expr_list m_args;
+  std::uint32_t m_num_args;
+
+  static bool classof(const expression *e) {
+    return e->getKind() == call_kind || e->getKind() == index_kind;
+  }
 };
 
 struct call_expr : postfix_expr {
-  call_expr(type *t, expression *e, const expr_list &args)
+  call_expr(type *t, expression *e, array_ref<expression *> args)
       : postfix_expr(call_kind, t, e, args) {}
 
   expression *getCallee() const { return m_base; }
+
+  static bool classof(const expression *e) { return e->getKind() == call_kind; }
 };
 
 struct index_expr : postfix_expr {
-  index_expr(type *t, expression *e, const expr_list &args)
+  index_expr(type *t, expression *e, array_ref<expression *> args)
       : postfix_expr(index_kind, t, e, args) {}
+
+  static bool classof(const expression *e) {
+    return e->getKind() == index_kind;
+  }
 }
 
+static_assert(sizeof(call_expr) == sizeof(postfix_expr) &&
+                  sizeof(index_expr) == sizeof(postfix_expr),
+              "the arguments must follow the whole node");
+
 struct cast_expr : expression {
   cast_expr(expression *e, type *t)
       : expression(cast_kind, t), m_src(e), m_dst(t) {}
 
   expression *m_src;
   type *m_dst;
+
+  static bool classof(const expression *e) { return e->getKind() == cast_kind; }
 };
 
 struct assign_expr : expression {
@@ -166,6 +206,10 @@ struct assign_expr : expression {
 
   expression *m_lhs;
   expression *m_rhs;
+
+  static bool classof(const expression *e) {
+    return e->getKind() == assign_kind;
+  }
 };
 
 struct cond_expr : expression {
@@ -179,6 +223,8 @@ struct cond_expr : expression {
   expression *m_cond;
   expression *m_true;
   expression *m_false;
+
+  static bool classof(const expression *e) { return e->getKind() == cond_kind; }
 };
 
 enum conversion {
@@ -200,4 +246,15 @@ struct conv_expr : expression {
 
   expr *m_src;
   conversion m_conv;
+
+  static bool classof(const expression *e) { return e->getKind() == conv_kind; }
+};
+
+// Stands in for an expression with a syntax error. It has no type.
+struct error_expr : expression {
+  error_expr() : expression(error_kind, nullptr) {}
+
+  static bool classof(const expression *e) {
+    return e->getKind() == error_kind;
+  }
 };
@@ -1,15 +1,95 @@
 #include "file.hpp"
 
-#include <iterator>
-#include <fstream>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
 
-file::file(const std::string& path) : m_path(path) {
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-  std::ifstream ifs(m_path);
+static std::runtime_error file_error(const std::string& path) {
+  return std::runtime_error(path + ": " + std::strerror(errno));
+}
+
+file::file(const std::string& path) : m_path(path),
+                                      m_first(nullptr),
+                                      m_last(nullptr),
+                                      m_map_size(0) {
+  if (m_path == "-") {
+    read(STDIN_FILENO);
+    return;
+  }
+
+  int fd = ::open(m_path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw file_error(m_path);
+
+  if (!map(fd))
+    read(fd);
+  ::close(fd);
+}
+
+file::~file() {
+  if (m_map_size)
+    ::munmap(const_cast<char*>(m_first), m_map_size);
+}
+
+// Maps a regular file so that it is followed by at least one zero byte.
+//
+// The bytes between the end of a file and the end of its last page read
+// as zero, but when the size is a multiple of the page size there are no
+// such bytes. Reserve one extra (anonymous, zero-filled) page and map the
+// file over the front of it so the sentinel always exists.
+bool file::map(int fd) {
+  struct stat st;
+  if (::fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+    return false;
+
+  std::size_t page = ::sysconf(_SC_PAGESIZE);
+  std::size_t size = st.st_size;
+  std::size_t span = (size / page + 1) * page;
+
+  void* base = ::mmap(nullptr, span, PROT_READ,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED)
+    return false;
+
+  void* text = ::mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+  if (text == MAP_FAILED) {
+    ::munmap(base, span);
+    return false;
+  }
+  ::madvise(text, size, MADV_SEQUENTIAL);
+
+  m_first = static_cast<const char*>(text);
+  m_last = m_first + size;
+  m_map_size = span;
+  return true;
+}
+
+line_column file::resolve(std::uint32_t offset) const {
+  std::call_once(m_lines_once, [this] { m_lines.add(m_first, m_last, 0); });
+  return m_lines.resolve(offset);
+}
 
-  std::istreambuf_iterator<char> first{ifs};
-  std::istreambuf_iterator<char> last{};
-  
-  m_text = std::string(first, last);
+// Reads the input into a buffer. This is the fallback for anything that
+// cannot be mapped. The std::string supplies the NUL sentinel.
+void file::read(int fd) {
+  char buf[64 * 1024];
+  while (true) {
+    ssize_t n = ::read(fd, buf, sizeof buf);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      throw file_error(m_path);
+    }
+    if (n == 0)
+      break;
+    m_text.append(buf, n);
+  }
 
+  m_first = m_text.data();
+  m_last = m_text.data() + m_text.size();
 }
@@ -1,21 +1,55 @@
+#include "location.hpp"
+
+#include <cstddef>
 #include <string>
 
-class file {
+// A source file. Regular files are memory-mapped and read in place; pipes,
+// terminals and stdin (the path "-") are read into a buffer instead.
+//
+// In either case the text in [begin(), end()) is followed by a NUL
+// character, so the lexer can stop on the sentinel rather than testing for
+// the end of input after every character.
+//
+// Line numbers are not computed until a location in the file is resolved.
+class file : public source {
   std::string m_path;
+
+  // The mapped or buffered text.
+  const char* m_first;
+  const char* m_last;
+
+  // Length of the mapping, or 0 if the text is held in m_text.
+  std::size_t m_map_size;
+
   std::string m_text;
-  
+
+  // Built on the first call to resolve()
+  mutable std::once_flag m_lines_once;
+  mutable line_map m_lines;
+
 public:
   file(const std::string& path);
+  ~file();
+
+  file(const file&) = delete;
+  file& operator=(const file&) = delete;
 
   const std::string& getPath() const;
-  const std::string& getText() const;
+  const std::string& getName() const override { return m_path; }
+
+  const char* begin() const { return m_first; }
+  const char* end() const { return m_last; }
+  std::size_t size() const { return m_last - m_first; }
+
+  bool isMapped() const { return m_map_size != 0; }
 
+  line_column resolve(std::uint32_t offset) const override;
+
+private:
+  bool map(int fd);
+  void read(int fd);
 };
 
 inline const std::string& file::getPath() const {
   return m_path;
 }
-
-inline const std::string& file::getText() const {
-  return m_text;
-}
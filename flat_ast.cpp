@@ -0,0 +1,430 @@
+#include "flat_ast.hpp"
+#include "type.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+// Each node is added before its children, so a walk from the root visits
+// the arrays mostly in order.
+flat_ast flat_ast::lower(const declaration *prog) {
+  flat_ast ast;
+  ast.lowerDecl(prog);
+  ast.m_decl_refs.clear();
+  ast.m_type_refs.clear();
+  assert(ast.matches(prog) && "the flat form differs from the tree");
+  return ast;
+}
+
+double flat_ast::getFloat(std::uint32_t i) const {
+  double val;
+  std::memcpy(&val, &m_extra[i], sizeof val);
+  return val;
+}
+
+std::size_t flat_ast::getSize() const {
+  return m_exprs.size() * sizeof(flat_expr) +
+         m_stmts.size() * sizeof(flat_stmt) +
+         m_decls.size() * sizeof(flat_decl) +
+         m_types.size() * sizeof(const type *) +
+         m_extra.size() * sizeof(std::uint32_t);
+}
+
+template <typename T, typename F>
+std::uint32_t flat_ast::addList(array_ref<T *> nodes, F lower) {
+  std::uint32_t i = m_extra.size();
+  m_extra.resize(i + 1 + nodes.size());
+  m_extra[i] = nodes.size();
+  for (std::size_t n = 0; n != nodes.size(); ++n) {
+    flat_ref r = lower(nodes[n]);
+    m_extra[i + 1 + n] = r;
+  }
+  return i;
+}
+
+flat_ref flat_ast::lowerType(const type *t) {
+  if (!t)
+    return flat_none;
+  auto iter = m_type_refs.find(t);
+  if (iter != m_type_refs.end())
+    return iter->second;
+  flat_ref r = m_types.size();
+  m_types.push_back(t);
+  m_type_refs.emplace(t, r);
+  return r;
+}
+
+// Expressions and statements are where the tree nests, so lowering and
+// matching bound their recursion there, as the parser does (see
+// stack.hpp). Declarations nest only through statements.
+flat_ref flat_ast::lowerExpr(const expression *e) {
+  return m_stack([this, e] { return lowerExprNode(e); });
+}
+
+flat_ref flat_ast::lowerStmt(const statement *s) {
+  return m_stack([this, s] { return lowerStmtNode(s); });
+}
+
+flat_ref flat_ast::lowerExprNode(const expression *e) {
+  if (!e)
+    return flat_none;
+
+  flat_ref r = m_exprs.size();
+  m_exprs.push_back({e->getKind(), 0, lowerType(e->getType()), {0, 0}});
+
+  std::uint8_t op = 0;
+  std::uint32_t data[2] = {0, 0};
+  switch (e->getKind()) {
+  case expression::bool_kind:
+    data[0] = cast<bool_expr>(e)->val;
+    break;
+  case expression::int_kind:
+    data[0] = cast<int_expr>(e)->val;
+    break;
+  case expression::float_kind: {
+    double val = cast<float_expr>(e)->val;
+    data[0] = m_extra.size();
+    m_extra.resize(m_extra.size() + sizeof val / sizeof(std::uint32_t));
+    std::memcpy(&m_extra[data[0]], &val, sizeof val);
+    break;
+  }
+  case expression::id_kind:
+    data[0] = getDeclRef(cast<id_expr>(e)->ref);
+    break;
+  case expression::uop_kind: {
+    auto *u = cast<uop_expr>(e);
+    op = u->m_op;
+    data[0] = lowerExpr(u->m_arg);
+    break;
+  }
+  case expression::bop_kind: {
+    auto *b = cast<bop_expr>(e);
+    op = b->m_op;
+    data[0] = lowerExpr(b->m_lhs);
+    data[1] = lowerExpr(b->m_rhs);
+    break;
+  }
+  case expression::call_kind:
+  case expression::index_kind: {
+    auto *p = cast<postfix_expr>(e);
+    data[0] = lowerExpr(p->m_base);
+    data[1] = addList(p->getArguments(),
+                      [this](const expression *a) { return lowerExpr(a); });
+    break;
+  }
+  case expression::cast_kind:
+    data[0] = lowerExpr(cast<cast_expr>(e)->m_src);
+    break;
+  case expression::assign_kind: {
+    auto *a = cast<assign_expr>(e);
+    data[0] = lowerExpr(a->m_lhs);
+    data[1] = lowerExpr(a->m_rhs);
+    break;
+  }
+  case expression::cond_kind: {
+    auto *c = cast<cond_expr>(e);
+    data[0] = lowerExpr(c->m_cond);
+    data[1] = m_extra.size();
+    m_extra.resize(m_extra.size() + 2);
+    flat_ref t = lowerExpr(c->m_true);
+    flat_ref f = lowerExpr(c->m_false);
+    m_extra[data[1]] = t;
+    m_extra[data[1] + 1] = f;
+    break;
+  }
+  case expression::conv_kind: {
+    auto *c = cast<conv_expr>(e);
+    op = c->m_conv;
+    data[0] = lowerExpr(c->m_src);
+    break;
+  }
+  case expression::error_kind:
+    break;
+  default:
+    throw std::logic_error("invalid expression");
+  }
+
+  flat_expr &x = m_exprs[r];
+  x.op = op;
+  x.data[0] = data[0];
+  x.data[1] = data[1];
+  return r;
+}
+
+flat_ref flat_ast::lowerStmtNode(const statement *s) {
+  if (!s)
+    return flat_none;
+
+  flat_ref r = m_stmts.size();
+  m_stmts.push_back({s->getKind(), {0, 0, 0}});
+
+  std::uint32_t data[3] = {0, 0, 0};
+  switch (s->getKind()) {
+  case statement::block_kind:
+    data[0] = addList(cast<block_stmt>(s)->getStatements(),
+                      [this](const statement *c) { return lowerStmt(c); });
+    break;
+  case statement::when_kind: {
+    auto *w = cast<when_stmt>(s);
+    data[0] = lowerExpr(w->m_cond);
+    data[1] = lowerStmt(w->m_body);
+    break;
+  }
+  case statement::if_kind: {
+    auto *i = cast<if_stmt>(s);
+    data[0] = lowerExpr(i->m_cond);
+    data[1] = lowerStmt(i->m_true);
+    data[2] = lowerStmt(i->m_false);
+    break;
+  }
+  case statement::while_kind: {
+    auto *w = cast<while_stmt>(s);
+    data[0] = lowerExpr(w->m_cond);
+    data[1] = lowerStmt(w->m_body);
+    break;
+  }
+  case statement::break_kind:
+  case statement::cont_kind:
+  case statement::error_kind:
+    break;
+  case statement::ret_kind:
+    data[0] = lowerExpr(cast<ret_stmt>(s)->m_val);
+    break;
+  case statement::decl_kind:
+    data[0] = lowerDecl(cast<decl_stmt>(s)->m_decl);
+    break;
+  case statement::expr_kind:
+    data[0] = lowerExpr(cast<expr_stmt>(s)->m_expr);
+    break;
+  default:
+    throw std::logic_error("invalid statement");
+  }
+
+  std::memcpy(m_stmts[r].data, data, sizeof data);
+  return r;
+}
+
+flat_ref flat_ast::getDeclRef(const declaration *d) {
+  auto iter = m_decl_refs.find(d);
+  if (iter != m_decl_refs.end())
+    return iter->second;
+  flat_ref r = m_decls.size();
+  m_decls.push_back(
+      {d->getName(), d->getKind(), flat_none, {flat_none, flat_none}});
+  m_decl_refs.emplace(d, r);
+  return r;
+}
+
+flat_ref flat_ast::lowerDecl(const declaration *d) {
+  flat_ref r = getDeclRef(d);
+
+  flat_ref t = flat_none;
+  std::uint32_t data[2] = {flat_none, flat_none};
+  switch (d->getKind()) {
+  case declaration::prog_kind:
+    data[0] = addList(cast<prog_decl>(d)->getDeclarations(),
+                      [this](const declaration *c) { return lowerDecl(c); });
+    break;
+  case declaration::var_kind:
+  case declaration::const_kind:
+  case declaration::val_kind:
+  case declaration::param_kind: {
+    auto *o = cast<obj_decl>(d);
+    t = lowerType(o->getType());
+    data[0] = lowerExpr(o->getInit());
+    break;
+  }
+  case declaration::func_kind: {
+    auto *f = cast<func_decl>(d);
+    t = lowerType(f->getType());
+    data[0] = addList(f->getParameters(),
+                      [this](const declaration *p) { return lowerDecl(p); });
+    data[1] = lowerStmt(f->m_body);
+    break;
+  }
+  case declaration::error_kind:
+    break;
+  default:
+    throw std::logic_error("invalid declaration");
+  }
+
+  flat_decl &x = m_decls[r];
+  x.type = t;
+  x.data[0] = data[0];
+  x.data[1] = data[1];
+  return r;
+}
+
+bool flat_ast::matches(const declaration *prog) const {
+  return !m_decls.empty() && matchDecl(getProgram(), prog);
+}
+
+bool flat_ast::matchType(flat_ref r, const type *t) const {
+  if (!t)
+    return r == flat_none;
+  return r < m_types.size() && m_types[r] == t;
+}
+
+template <typename T, typename F>
+bool flat_ast::matchList(std::uint32_t i, array_ref<T *> nodes,
+                         F match) const {
+  if (i >= m_extra.size() || m_extra[i] != nodes.size() ||
+      m_extra.size() - i - 1 < nodes.size())
+    return false;
+  flat_list list = getList(i);
+  for (std::size_t n = 0; n != nodes.size(); ++n)
+    if (!match(list.first[n], nodes[n]))
+      return false;
+  return true;
+}
+
+bool flat_ast::matchExpr(flat_ref r, const expression *e) const {
+  return m_stack([this, r, e] { return matchExprNode(r, e); });
+}
+
+bool flat_ast::matchStmt(flat_ref r, const statement *s) const {
+  return m_stack([this, r, s] { return matchStmtNode(r, s); });
+}
+
+bool flat_ast::matchExprNode(flat_ref r, const expression *e) const {
+  if (!e)
+    return r == flat_none;
+  if (r >= m_exprs.size())
+    return false;
+  const flat_expr &x = m_exprs[r];
+  if (x.kind != e->getKind() || !matchType(x.type, e->getType()))
+    return false;
+
+  auto match = [this](flat_ref r, const expression *a) {
+    return matchExpr(r, a);
+  };
+  switch (e->getKind()) {
+  case expression::bool_kind:
+    return x.data[0] == cast<bool_expr>(e)->val;
+  case expression::int_kind:
+    return x.data[0] == std::uint32_t(cast<int_expr>(e)->val);
+  case expression::float_kind: {
+    double val = cast<float_expr>(e)->val;
+    double flat = getFloat(x.data[0]);
+    return std::memcmp(&val, &flat, sizeof val) == 0;
+  }
+  case expression::id_kind: {
+    const declaration *d = cast<id_expr>(e)->ref;
+    return x.data[0] < m_decls.size() &&
+           m_decls[x.data[0]].name == d->getName() &&
+           m_decls[x.data[0]].kind == d->getKind();
+  }
+  case expression::uop_kind: {
+    auto *u = cast<uop_expr>(e);
+    return x.op == u->m_op && matchExpr(x.data[0], u->m_arg);
+  }
+  case expression::bop_kind: {
+    auto *b = cast<bop_expr>(e);
+    return x.op == b->m_op && matchExpr(x.data[0], b->m_lhs) &&
+           matchExpr(x.data[1], b->m_rhs);
+  }
+  case expression::call_kind:
+  case expression::index_kind: {
+    auto *p = cast<postfix_expr>(e);
+    return matchExpr(x.data[0], p->m_base) &&
+           matchList(x.data[1], p->getArguments(), match);
+  }
+  case expression::cast_kind:
+    return matchExpr(x.data[0], cast<cast_expr>(e)->m_src);
+  case expression::assign_kind: {
+    auto *a = cast<assign_expr>(e);
+    return matchExpr(x.data[0], a->m_lhs) && matchExpr(x.data[1], a->m_rhs);
+  }
+  case expression::cond_kind: {
+    auto *c = cast<cond_expr>(e);
+    return x.data[1] + 1 < m_extra.size() && matchExpr(x.data[0], c->m_cond) &&
+           matchExpr(m_extra[x.data[1]], c->m_true) &&
+           matchExpr(m_extra[x.data[1] + 1], c->m_false);
+  }
+  case expression::conv_kind: {
+    auto *c = cast<conv_expr>(e);
+    return x.op == c->m_conv && matchExpr(x.data[0], c->m_src);
+  }
+  case expression::error_kind:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool flat_ast::matchStmtNode(flat_ref r, const statement *s) const {
+  if (!s)
+    return r == flat_none;
+  if (r >= m_stmts.size())
+    return false;
+  const flat_stmt &x = m_stmts[r];
+  if (x.kind != s->getKind())
+    return false;
+
+  switch (s->getKind()) {
+  case statement::block_kind:
+    return matchList(x.data[0], cast<block_stmt>(s)->getStatements(),
+                     [this](flat_ref r, const statement *c) {
+                       return matchStmt(r, c);
+                     });
+  case statement::when_kind: {
+    auto *w = cast<when_stmt>(s);
+    return matchExpr(x.data[0], w->m_cond) && matchStmt(x.data[1], w->m_body);
+  }
+  case statement::if_kind: {
+    auto *i = cast<if_stmt>(s);
+    return matchExpr(x.data[0], i->m_cond) &&
+           matchStmt(x.data[1], i->m_true) && matchStmt(x.data[2], i->m_false);
+  }
+  case statement::while_kind: {
+    auto *w = cast<while_stmt>(s);
+    return matchExpr(x.data[0], w->m_cond) && matchStmt(x.data[1], w->m_body);
+  }
+  case statement::break_kind:
+  case statement::cont_kind:
+  case statement::error_kind:
+    return true;
+  case statement::ret_kind:
+    return matchExpr(x.data[0], cast<ret_stmt>(s)->m_val);
+  case statement::decl_kind:
+    return matchDecl(x.data[0], cast<decl_stmt>(s)->m_decl);
+  case statement::expr_kind:
+    return matchExpr(x.data[0], cast<expr_stmt>(s)->m_expr);
+  default:
+    return false;
+  }
+}
+
+bool flat_ast::matchDecl(flat_ref r, const declaration *d) const {
+  if (r >= m_decls.size())
+    return false;
+  const flat_decl &x = m_decls[r];
+  if (x.name != d->getName() || x.kind != d->getKind())
+    return false;
+
+  auto match = [this](flat_ref r, const declaration *c) {
+    return matchDecl(r, c);
+  };
+  switch (d->getKind()) {
+  case declaration::prog_kind:
+    return matchList(x.data[0], cast<prog_decl>(d)->getDeclarations(), match);
+  case declaration::var_kind:
+  case declaration::const_kind:
+  case declaration::val_kind:
+  case declaration::param_kind: {
+    auto *o = cast<obj_decl>(d);
+    return matchType(x.type, o->getType()) &&
+           matchExpr(x.data[0], o->getInit());
+  }
+  case declaration::func_kind: {
+    auto *f = cast<func_decl>(d);
+    return matchType(x.type, f->getType()) &&
+           matchList(x.data[0], f->getParameters(), match) &&
+           matchStmt(x.data[1], f->m_body);
+  }
+  case declaration::error_kind:
+    return true;
+  default:
+    return false;
+  }
+}
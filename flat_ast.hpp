@@ -0,0 +1,166 @@
+#pragma once
+
+//
+// A flat, index-based copy of an abstract syntax tree
+//
+// The pointer AST scatters polymorphic nodes across the heap. A flat_ast
+// holds the same tree in three arrays, one each for expressions,
+// statements and declarations, of small fixed-size records. Nodes refer
+// to each other by 32-bit indices into those arrays, and nodes with a
+// variable number of children keep them in a shared array of extra words.
+// Types are few and shared, so each distinct type is stored once and
+// referred to by index.
+//
+// The flat form is built from a finished tree by lower(), for passes that
+// walk the whole program; codegen generates function bodies from it.
+//
+
+#include "declaration.hpp"
+#include "expression.hpp"
+#include "stack.hpp"
+#include "statement.hpp"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class type;
+
+// An index into one of a flat_ast's arrays
+using flat_ref = std::uint32_t;
+
+constexpr flat_ref flat_none = UINT32_MAX;
+
+// The meaning of data depends on the kind:
+//
+//   bool, int       the value
+//   float           the extra index of the value, in two words
+//   id              the declaration
+//   uop, cast, conv the operand; op is the uop or conversion
+//   bop             the operands; op is the bop
+//   assign          the operands
+//   call, index     the base, and the extra index of the argument list
+//   cond            the condition, and the extra index of the two values
+struct flat_expr {
+  expression::kind kind : 8;
+  std::uint8_t op;
+  flat_ref type;
+  std::uint32_t data[2];
+};
+
+static_assert(sizeof(flat_expr) == 16, "flat_expr should be 16 bytes");
+
+// The meaning of data depends on the kind:
+//
+//   block           the extra index of the statement list
+//   when, while     the condition and the body
+//   if              the condition and the two branches
+//   ret             the value, or flat_none
+//   decl            the declaration
+//   expr            the expression
+struct flat_stmt {
+  statement::kind kind : 8;
+  std::uint32_t data[3];
+};
+
+static_assert(sizeof(flat_stmt) == 16, "flat_stmt should be 16 bytes");
+
+// The meaning of data depends on the kind:
+//
+//   prog            the extra index of the declaration list
+//   var, const, val the initializer, or flat_none
+//   func            the extra index of the parameter list, and the body
+//                   or flat_none
+struct flat_decl {
+  symbol name;
+  declaration::kind kind : 8;
+  flat_ref type;
+  std::uint32_t data[2];
+};
+
+static_assert(sizeof(flat_decl) == 24, "flat_decl should be 24 bytes");
+
+// A list of references in the extra array
+struct flat_list {
+  const flat_ref *begin() const { return first; }
+  const flat_ref *end() const { return first + size; }
+
+  const flat_ref *first;
+  std::uint32_t size;
+};
+
+class flat_ast {
+public:
+  // Builds the flat form of a program.
+  static flat_ast lower(const declaration *prog);
+
+  const flat_expr &getExpr(flat_ref r) const { return m_exprs[r]; }
+  const flat_stmt &getStmt(flat_ref r) const { return m_stmts[r]; }
+  const flat_decl &getDecl(flat_ref r) const { return m_decls[r]; }
+  const type *getType(flat_ref r) const { return m_types[r]; }
+
+  // The list stored at index i of the extra array
+  flat_list getList(std::uint32_t i) const {
+    return {m_extra.data() + i + 1, m_extra[i]};
+  }
+
+  // The word at index i of the extra array, such as one of the two values
+  // of a conditional
+  std::uint32_t getExtra(std::uint32_t i) const { return m_extra[i]; }
+
+  double getFloat(std::uint32_t i) const;
+
+  // The program, which is the first declaration
+  flat_ref getProgram() const { return 0; }
+
+  std::size_t getNumExprs() const { return m_exprs.size(); }
+  std::size_t getNumStmts() const { return m_stmts.size(); }
+  std::size_t getNumDecls() const { return m_decls.size(); }
+
+  // The memory used by the nodes and the extra array
+  std::size_t getSize() const;
+
+  // Whether this is the flat form of prog: each node has the same kind,
+  // type, operator, value and children as its counterpart in the tree.
+  // lower() checks this in debug builds.
+  bool matches(const declaration *prog) const;
+
+private:
+  flat_ref lowerExpr(const expression *e);
+  flat_ref lowerStmt(const statement *s);
+  flat_ref lowerExprNode(const expression *e);
+  flat_ref lowerStmtNode(const statement *s);
+  flat_ref lowerDecl(const declaration *d);
+  flat_ref lowerType(const type *t);
+
+  // The index of a declaration, reserved on first use since an id can
+  // refer to a declaration that has not been lowered yet
+  flat_ref getDeclRef(const declaration *d);
+
+  template <typename T, typename F>
+  std::uint32_t addList(array_ref<T *> nodes, F lower);
+
+  bool matchExpr(flat_ref r, const expression *e) const;
+  bool matchStmt(flat_ref r, const statement *s) const;
+  bool matchExprNode(flat_ref r, const expression *e) const;
+  bool matchStmtNode(flat_ref r, const statement *s) const;
+  bool matchDecl(flat_ref r, const declaration *d) const;
+  bool matchType(flat_ref r, const type *t) const;
+
+  template <typename T, typename F>
+  bool matchList(std::uint32_t i, array_ref<T *> nodes, F match) const;
+
+  std::vector<flat_expr> m_exprs;
+  std::vector<flat_stmt> m_stmts;
+  std::vector<flat_decl> m_decls;
+  std::vector<const type *> m_types;
+  std::vector<std::uint32_t> m_extra;
+
+  // Bounds the native stack used by nested expressions and statements,
+  // both while lowering and while matching
+  mutable stack_guard m_stack;
+
+  // Used while lowering
+  std::unordered_map<const declaration *, flat_ref> m_decl_refs;
+  std::unordered_map<const type *, flat_ref> m_type_refs;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+//
+// Keyword recognition
+//
+// Keywords are found with a perfect hash over the raw spelling, before a
+// word is interned: the hash of a keyword is its slot in a 32-entry table,
+// so a lookup costs one hash, one length test and one comparison.
+//
+
+#include "token.hpp"
+
+#include <cstring>
+
+struct keyword {
+  const char* spelling;
+  unsigned char len;
+  token_name name;
+  unsigned char attr;
+};
+
+// Keywords, same order as in token.hpp
+constexpr keyword keyword_list[] = {
+  { "and",   3, tok_logical_op,     logical_and },
+  { "bool",  4, tok_type_specifier, ts_bool },
+  { "char",  4, tok_type_specifier, ts_char },
+  { "def",   3, kw_def,             0 },
+  { "else",  4, kw_else,            0 },
+  { "false", 5, tok_boolean,        false },
+  { "float", 5, tok_type_specifier, ts_float },
+  { "if",    2, kw_if,              0 },
+  { "int",   3, tok_type_specifier, ts_int },
+  { "let",   3, kw_let,             0 },
+  { "not",   3, tok_logical_op,     logical_not },
+  { "or",    2, tok_logical_op,     logical_or },
+  { "true",  4, tok_boolean,        true },
+  { "var",   3, kw_var,             0 },
+};
+
+constexpr unsigned keyword_slots = 32;
+
+// The first and last characters are enough to tell the keywords apart.
+constexpr unsigned keyword_hash(char first, char last) {
+  return ((unsigned char)first + 7 * (unsigned char)last) % keyword_slots;
+}
+
+struct keyword_table {
+  const keyword* slots[keyword_slots];
+};
+
+constexpr keyword_table make_keyword_table() {
+  keyword_table t{};
+  for (const keyword& kw : keyword_list) {
+    unsigned h = keyword_hash(kw.spelling[0], kw.spelling[kw.len - 1]);
+    if (t.slots[h])
+      throw "keyword hash collision";
+    t.slots[h] = &kw;
+  }
+  return t;
+}
+
+inline constexpr keyword_table keywords = make_keyword_table();
+
+// Returns the keyword spelled by the non-empty range [first, last), or null.
+inline const keyword* find_keyword(const char* first, const char* last) {
+  const keyword* kw = keywords.slots[keyword_hash(*first, *(last - 1))];
+  if (kw && kw->len == last - first &&
+      std::memcmp(kw->spelling, first, kw->len) == 0)
+    return kw;
+  return nullptr;
+}
@@ -4,35 +4,21 @@
 
 #include "lexer.hpp"
 #include "file.hpp"
+#include "stream.hpp"
+#include "skip.hpp"
+#include "dfa.hpp"
+#include "keyword.hpp"
 
-#include <sstream>
 #include <iostream>
 #include <cassert>
-#include <cctype>
+#include <charconv>
 
 // -------------------------------------
 // Character classes
 // -------------------------------------
-static bool is_digit(char c) {
-  return std::isdigit(c);
-}
-
-static bool is_nondigit(char c) {
-  return std::isalpha(c) || c == '_';
-}
-
-static bool is_alphanumeric(char c) {
-  return std::isalnum(c);
-}
-
-static bool is_binary_digit(char c) {
-  return c == '0' || c == '1';
-}
-
-static bool is_hexadecimal_digit(char c) {
-  return std::isxdigit(c);
-}
-
+//
+// Words, numbers and operators are recognized by the DFA in dfa.hpp; the
+// remaining tests are for the hand-written literal and blank scanners.
 static bool is_space(char c) {
   return c == ' ' || c == '\t';
 }
@@ -45,54 +31,68 @@ static bool is_newline(char c) {
 // -------------------------------------
 // Lexer classes
 // -------------------------------------
-static const char* getStartOfInput(std::string& f) {
-  return f.getText().data();
+// The input is always followed by a NUL sentinel (see file.hpp), so the
+// scanning loops below stop on it without checking for the end of input.
+static const char* getStartOfInput(const file& f) {
+  return f.begin();
 }
 
 
-static const char* getEndOfInput(std::string& f) {
-  return f.getText().data() + f.getText().size();
+static const char* getEndOfInput(const file& f) {
+  return f.end();
 }
 
-lexer::lexer(symbol_table& syms, const file& f) : symbols(syms),
-                                                  m_first(getStartOfInput(f)),
-                                                  m_last(getEndOfInput(f)),
-                                                  m_current_loc(f, 0, 0) {
-  m_reserved.insert({
-
-    // Keywords, same order as in token.hpp
-    { m_syms.get("and"),    logical_and },
-    { m_syms.get("bool"),   ts_bool },
-    { m_syms.get("char"),   ts_char },
-    { m_syms.get("def"),    kw_def  },
-    { m_syms.get("else"),   kw_else },
-    { m_syms.get("false"),  false },
-    { m_syms.get("float"),  ts_float},
-    { m_syms.get("if"),     kw_if   },
-    { m_syms.get("int"),    ts_int  },
-    { m_syms.get("let"),    kw_let  },
-    { m_syms.get("not"),    logical_not },
-    { m_syms.get("or"),     logical_or  },
-    { m_syms.get("true"),   true  },
-    { m_syms.get("var"),    kw_var  },
-  });
+lexer::lexer(symbol_table& syms, const file& f)
+    : lexer(syms, f, getStartOfInput(f), getEndOfInput(f), nullptr) { }
+
+
+
+lexer::lexer(symbol_table& syms, const source& src, const char* text,
+             std::size_t first, std::size_t last)
+    : lexer(syms, src, text + first, text + last, nullptr) {
+  assert(first <= last);
+  m_window = text;
 }
 
 
 
+// The window starts out empty; the first call to scan() fills it.
+lexer::lexer(symbol_table& syms, input_stream& s)
+    : lexer(syms, s, s.begin(), s.end(), &s) { }
+
+
+
+lexer::lexer(symbol_table& syms, const source& src, const char* first,
+             const char* last, input_stream* s) : m_syms(syms),
+                                                  m_first(first),
+                                                  m_last(last),
+                                                  m_token_first(first),
+                                                  m_stream(s),
+                                                  m_window(first),
+                                                  m_base(0),
+                                                  m_source(src.getId()) { }
+
+
+
 bool lexer::eof() const {
   return m_first == m_last;
 }
 
 
 
-char lexer::peek() const {
-  return eof() ? 0 : *m_first;
+// Only a NUL can be the sentinel, so other characters are returned
+// without looking at the end of the window.
+char lexer::peek() {
+  if (*m_first == 0 && eof())
+    underflow();
+  return *m_first;
 }
 
 
 
-char lexer::peek(int n) const {
+char lexer::peek(int n) {
+  if (n >= m_last - m_first)
+    underflow();
   if (n < m_last - m_first)
     return *(m_first + n);
   else
@@ -101,237 +101,228 @@ char lexer::peek(int n) const {
 
 
 
-char lexer::accept() {
-  assert(*m_first != '\n');
-  char c = *m_first;
-  ++m_first;
-  ++m_current_loc.column;
-  return c;
+// Pulls the next chunk of a streamed input into the window, keeping the
+// text of the current token. For an in-memory file there is nothing more.
+bool lexer::underflow() {
+  if (!m_stream || m_stream->done())
+    return false;
+
+  std::ptrdiff_t pos = m_first - m_token_first;
+  bool more = m_stream->refill(m_token_first);
+  m_token_first = m_stream->begin();
+  m_first = m_token_first + pos;
+  m_last = m_stream->end();
+  m_window = m_stream->begin();
+  m_base = m_stream->getOffset();
+  return more;
 }
 
 
 
-void lexer::accept(int n) {
-  // FIXME: This is slow, but we do it for the assertions.
-  while (n) {
-    accept();
-    --n;
-  }
+char lexer::accept() {
+  return *m_first++;
 }
 
 
 
+char lexer::accept(int n) {
+  m_first += n;
+  return m_first[-1];
+}
 
-token lexer::scan() {
-  while (!eof()) {
 
-    m_token_loc = m_current_loc;
 
-    switch (*m_first) {
-      // Ignore whitespace
-      case ' ':
-      case '\t':  skip_space();   continue;
-      case '\n':  skip_newline(); continue;
-      case '#':   skip_comment(); continue;
-
-      // Punctuators
-      case '(':   return lex_punctuator(tok_left_paren);
-      case ')':   return lex_punctuator(tok_right_paren);
-      case '[':   return lex_punctuator(tok_left_bracket);
-      case ']':   return lex_punctuator(tok_right_bracket);
-      case '{':   return lex_punctuator(tok_left_brace);
-      case '}':   return lex_punctuator(tok_right_brace);
-      case ',':   return lex_punctuator(tok_comma);
-      case ';':   return lex_punctuator(tok_semicolon);
-      case ':':   return lex_punctuator(tok_colon);
-
-      // Operators
-      case '<':   if (peek(1) == '=') return lex_relational_op(2, op_le);
-                  if (peek(1) == '<') return lex_bitwise_op(2, op_shl);
-                  return lex_relational_op(1, op_lt);
-
-      case '>':   if (peek(1) == '=') return lex_relational_op(2, op_ge);
-                  if (peek(1) == '>') return lex_bitwise_op(2, op_shr);
-                  return lex_relational_op(1, op_gt);
-
-      case '=':   if (peek(1) == '=') return lex_relational_op(2, op_eq);
-                  else return lex_assignment_op();
-
-      case '+':   return lex_arithmetic_op(op_add);
-      case '-':   return lex_arithmetic_op(op_sub);
-      case '*':   return lex_arithmetic_op(op_mul);
-      case '/':   return lex_arithmetic_op(op_quo);
-      case '%':   return lex_arithmetic_op(op_rem);
-      case '&':   return lex_bitwise_op(1, op_and);
-      case '|':   return lex_bitwise_op(1, op_ior);
-      case '^':   return lex_bitwise_op(1, op_xor);
-      case '~':   return lex_bitwise_op(1, op_not);
-      case '?':   return lex_conditional_op();
-      case '\'':  return lex_character();
-      case '"':   return lex_string();
-
-      default: {
-        if (is_nondigit(*m_first))
-          return lex_word();
-        else if (is_digit(*m_first))
-          return lex_number();
-
-        std::stringstream ss;
-        ss << "invalid character '" << *m_first << '\'';
-        throw std::runtime_error(ss.str());
-      }
-    }
-  }
-  return {};
-}
 
+// Runs the DFA in dfa.hpp from the start of the token. The state it stops
+// in selects the action; words, numbers and operators have been consumed
+// by then, while blanks and literals are handed to their own scanners.
+token lexer::scan() {
+  while (true) {
 
-// Whitespace skipping helper functions
-void lexer::skip_space() {
-  assert(is_space(*m_first));
-  ignore();
-  while (!eof() && is_space(*m_first))
-    ignore();
-}
+    m_token_first = m_first;
+    m_token_loc = location(m_source, m_base + (m_first - m_window));
 
-void lexer::skip_newline() {
-  assert(*m_first == '\n');
-  m_current_loc.line += 1;
-  m_current_loc.column = 0;
-  ++m_first;
-}
+    // A sub-range of a file is not followed by the sentinel
+    if (eof() && !underflow())
+      return {tok_eof, m_token_loc};
 
-void lexer::skip_comment() {
-  assert(*m_first == '#');
-  ignore();
-  while (!eof() && !is_newline(*m_first))
-    ignore();
-}
+    const char* p = m_first;
+    unsigned state = st_start;
+    while (unsigned next = dfa.next[state][dfa.cls[(unsigned char)*p]]) {
+      state = next;
+      ++p;
+    }
 
+    // The token may continue past the end of a streamed window
+    if (p == m_last && underflow())
+      continue;
 
+    switch (dfa.action[state]) {
+      // The sentinel; anywhere else a NUL is just an invalid character
+      case act_end:       if (!eof()) break;
+                          return {tok_eof, m_token_loc};
 
-token lexer::lex_punctuator(token_name n) {
-  accept();
-  return { n, m_token_loc };
-}
+      // Ignore whitespace
+      case act_blank:     skip_space();   continue;
+      case act_comment:   skip_comment(); continue;
 
+      case act_character: return lex_character();
+      case act_string:    return lex_string();
+      case act_error:     break;
 
+      default:
+        m_first = p;
+        return lex_fixed(state);
+    }
 
-token lexer::lex_relational_op(int len, relational_op op) {
-  accept(len);
-  return { op, m_token_loc };
+    accept();
+    return {err_invalid_character, m_token_loc};
+  }
 }
 
 
 
-token lexer::lex_arithmetic_op(arithmetic_op op) {
-  accept();
-  return { op, m_token_loc };
+// Builds the token for the text consumed by the DFA, [m_token_first, m_first).
+token lexer::lex_fixed(unsigned state) {
+  unsigned char attr = dfa.attr[state];
+  switch (dfa.action[state]) {
+    case act_punctuator:     return { token_name(attr), m_token_loc };
+    case act_relational_op:  return { relational_op(attr), m_token_loc };
+    case act_arithmetic_op:  return { arithmetic_op(attr), m_token_loc };
+    case act_bitwise_op:     return { bitwise_op(attr), m_token_loc };
+    case act_assignment_op:  return { tok_assignment_op, m_token_loc };
+    case act_conditional_op: return { tok_conditional_op, m_token_loc };
+    case act_word:           return lex_word();
+    case act_decimal:        return lex_decimal_number();
+    case act_floating_point: return lex_floating_point_number();
+    case act_binary:         return lex_binary_number();
+    case act_hexadecimal:    return lex_hexadecimal_number();
+    default:                 throw std::logic_error("invalid lexer state");
+  }
 }
 
 
+// Whitespace skipping helper functions
+//
+// Runs of blanks are skipped a vector at a time (see skip.hpp). Newlines
+// need no special handling since lines are only counted on demand.
+void lexer::skip_space() {
+  assert(is_space(*m_first) || is_newline(*m_first));
+  while (true) {
+    m_first = m_token_first = skip_blanks(m_first, m_last);
 
-token lexer::lex_bitwise_op(int len, bitwise_op op) {
-  accept(len);
-  return { op, m_token_loc };
+    if (!eof() || !underflow())
+      return;
+  }
 }
 
+// A comment runs up to, but not including, the next newline.
+void lexer::skip_comment() {
+  assert(*m_first == '#');
+  while (true) {
+    const char* p = find_newline(m_first, m_last);
+    m_first = m_token_first = p;
 
-
-token lexer::lex_assignment_op() {
-  accept();
-  return { tok_assignment_op, m_token_loc };
+    if (!eof() || !underflow())
+      return;
+  }
 }
 
 
 
-token lexer::lex_conditional_op() {
-  accept();
-  return { tok_conditional_op, m_token_loc };
-}
+// Keywords are recognized from the raw spelling; only identifiers are
+// interned.
+token lexer::lex_word() {
+  if (const keyword* kw = find_keyword(m_token_first, m_first)) {
+    switch (kw->name) {
+      case tok_logical_op:      return {logical_op(kw->attr), m_token_loc};
+      case tok_type_specifier:  return {type_spec(kw->attr), m_token_loc};
+      case tok_boolean:         return {bool(kw->attr), m_token_loc};
+      default:                  return {kw->name, m_token_loc};
+    }
+  }
 
+  std::string_view str(m_token_first, m_first - m_token_first);
+  return {m_syms.get(str), m_token_loc};
+}
 
 
 
-token lexer::lex_word() {
-  assert(is_nondigit(*m_first));
-  const char* start = m_first;
 
-  accept();
-  while (!eof() && is_alphanumeric(*m_first))
-    accept();
+// Numbers are converted in place from the source range. A literal that
+// does not fit in 64 bits is an error rather than being truncated; binary
+// and hexadecimal literals may use all 64 bits as a two's complement
+// pattern.
+static bool to_integer(const char* first, const char* last, int base,
+                       long long& val) {
+  // "0b" and "0x" with no digits have always meant zero.
+  if (first == last) {
+    val = 0;
+    return true;
+  }
 
-  std::string str(start, m_first);
-  symbol sym = m_syms.get(str);
-  auto iter = m_reserved.find(sym);
-  if (iter != m_reserved.end()) {
-    const token& tok = iter->second;
-    return {tok.getName(), tok.get_attribute(), m_token_loc};
+  std::from_chars_result r;
+  if (base == 10)
+    r = std::from_chars(first, last, val, base);
+  else {
+    unsigned long long bits;
+    r = std::from_chars(first, last, bits, base);
+    val = static_cast<long long>(bits);
   }
-  else
-    return {sym, m_token_loc};
+  if (r.ec == std::errc::result_out_of_range)
+    return false;
+  assert(r.ec == std::errc() && r.ptr == last);
+  return true;
 }
 
+// from_chars is correctly rounded.
+static bool to_floating_point(const char* first, const char* last,
+                              double& val) {
+  std::from_chars_result r = std::from_chars(first, last, val);
+  if (r.ec == std::errc::result_out_of_range)
+    return false;
+  assert(r.ec == std::errc() && r.ptr == last);
+  return true;
+}
 
 
 
-token lexer::lex_number() {
-  assert(isdigit(*m_first));
-  const char* start = m_first;
-
-  if (*m_first == '0') {
-    char pre = peek(1);
-    switch (pre) {
-      case 'b': case 'B': return lex_binary_number();
-      case 'x': case 'X': return lex_hexadecimal_number();
-      default: break;
-    }
-  }
 
-  accept();
-  while (!eof() && is_digit(*m_first))
-    accept();
+token lexer::lex_decimal_number() {
+  long long val;
+  if (!to_integer(m_token_first, m_first, 10, val))
+    return {err_integer_out_of_range, m_token_loc};
+  return {decimal, val, m_token_loc};
+}
 
-  if (peek() != '.') {
-    std::string str(start, m_first);
-    return {decimal, std::atoi(str.c_str()), m_token_loc};
-  }
 
-  accept();
-  while (!eof() && is_digit(*m_first))
-    accept();
 
 
-  std::string str(start, m_first);
-  return {std::atof(str.c_str()), m_token_loc};
+token lexer::lex_floating_point_number() {
+  double val;
+  if (!to_floating_point(m_token_first, m_first, val))
+    return {err_floating_point_out_of_range, m_token_loc};
+  return {val, m_token_loc};
 }
 
 
 
 
 token lexer::lex_binary_number() {
-  accept(2);
-
-  const char* start = m_first;
-  while (!eof() && is_binary_digit(*m_first))
-    accept();
-
-  std::string str(start, m_first);
-  return {binary, std::strtoll(str.c_str(), nullptr, 2), m_token_loc};
+  long long val;
+  if (!to_integer(m_token_first + 2, m_first, 2, val))
+    return {err_integer_out_of_range, m_token_loc};
+  return {binary, val, m_token_loc};
 }
 
 
 
 
 token lexer::lex_hexadecimal_number() {
-  accept(2);
-
-  const char* start = m_first;
-  while (!eof() && is_hexadecimal_digit(*m_first))
-    accept();
-
-  std::string str(start, m_first);
-  return {hexadecimal, std::strtoll(str.c_str(), nullptr, 16), m_token_loc};
+  long long val;
+  if (!to_integer(m_token_first + 2, m_first, 16, val))
+    return {err_integer_out_of_range, m_token_loc};
+  return {hexadecimal, val, m_token_loc};
 }
 
 
@@ -340,82 +331,117 @@ static bool is_character_character(char c){
 }
 
 
-char lexer::scan_escape_sequence() {
+bool lexer::scan_escape_sequence(char& c, lex_error& e) {
   assert(*m_first == '\\');
   accept();
-  if (eof())
-    throw std::runtime_error("unterminated escape-sequence");
+  if (peek() == '\n' || eof()) {
+    e = err_unterminated_escape;
+    return false;
+  }
   switch (accept()) {
-  case '\'':  return '\'';
-  case '\"':  return '\"';
-  case '\\':  return '\\';
-  case 'a':   return '\a';
-  case 'b':   return '\b';
-  case 'f':   return '\f';
-  case 'n':   return '\n';
-  case 'r':   return '\r';
-  case 't':   return '\t';
-  case 'v':   return '\v';
-  default:    throw std::runtime_error("invalid escape-sequence");
+  case '\'':  c = '\''; return true;
+  case '\"':  c = '\"'; return true;
+  case '\\':  c = '\\'; return true;
+  case 'a':   c = '\a'; return true;
+  case 'b':   c = '\b'; return true;
+  case 'f':   c = '\f'; return true;
+  case 'n':   c = '\n'; return true;
+  case 'r':   c = '\r'; return true;
+  case 't':   c = '\t'; return true;
+  case 'v':   c = '\v'; return true;
+  default:    e = err_invalid_escape; return false;
   }
 }
 
 
 
+// Skips the rest of a bad literal, up to and including the closing quote,
+// so that lexing resumes after it. The skip never goes past the end of the
+// line: a literal cannot span one, so the next line is always a clean
+// start.
+token lexer::recover(lex_error e, char close) {
+  while (peek() != '\n' && !(*m_first == 0 && eof())) {
+    char c = accept();
+    if (c == close)
+      break;
+    if (c == '\\' && peek() != '\n' && !(*m_first == 0 && eof()))
+      accept();
+  }
+  return {e, m_token_loc};
+}
+
+
+
 
 token lexer::lex_character() {
   assert(*m_first == '\'');
   accept();
 
-  if (eof())
-    throw std::runtime_error("unterminated character literal");
+  if (peek() == 0 && eof())
+    return {err_unterminated_character, m_token_loc};
 
   char c;
-  if (*m_first == '\\')
-    c = scan_escape_sequence();
+  lex_error e;
+  if (*m_first == '\\') {
+    if (!scan_escape_sequence(c, e))
+      return recover(e, '\'');
+  }
   else if (is_character_character(*m_first))
     c = accept();
   else if (*m_first == '\'')
-    throw std::runtime_error("invalid character literal");
+    return recover(err_empty_character, '\'');
   else if (*m_first == '\n')
-    throw std::runtime_error("invalid multi-line character");
+    return {err_multiline_character, m_token_loc};
   else
     throw std::logic_error("unexpected character");
 
-  if (*m_first != '\'')
-    throw std::runtime_error("invalid multi-byte character");
+  if (peek() != '\'')
+    return recover(err_multibyte_character, '\'');
   accept();
 
   return {c, m_token_loc};
 }
 
-static bool is_string_character(char c) {
-  return c != '\n' && c != '"';
-}
 
 
 
+static bool is_plain_string_character(char c) {
+  return c != '"' && c != '\\' && c != '\n' && c != 0;
+}
+
+
 
+// A literal without escapes is left where it is in the source (see
+// string_attr). Otherwise, or when the source is a streamed window that
+// will be overwritten, the text is unescaped into m_strings.
 token lexer::lex_string() {
   assert(*m_first == '"');
   accept();
 
-  if (eof())
-    throw std::runtime_error("unterminated character literal");
+  while (is_plain_string_character(peek()) || (*m_first == 0 && !eof()))
+    accept();
+  if (*m_first == '"' && !m_stream) {
+    accept();
+    return {string_attr{m_token_first}, m_token_loc};
+  }
 
-  std::string str;
-  str.reserve(32);
-  while (*m_first != '"') {
+  std::string str(m_token_first + 1, m_first);
+  while (peek() != '"') {
     char c;
-    if (*m_first == '\\')
-      c = scan_escape_sequence();
-    else if (is_string_character(*m_first))
-      c = accept();
+    lex_error e;
+    if (*m_first == '\\') {
+      if (!scan_escape_sequence(c, e))
+        return recover(e, '"');
+    }
     else if (*m_first == '\n')
-      throw std::runtime_error("invalid multi-line string");
+      return {err_multiline_string, m_token_loc};
+    else if (eof())
+      return {err_unterminated_string, m_token_loc};
+    else
+      c = accept();
     str += c;
   }
   accept();
 
-  return {string_attr{m_syms.get(str)}, m_token_loc};
+  return {string_attr::copy(m_strings, str), m_token_loc};
 }
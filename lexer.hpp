@@ -1,3 +1,5 @@
+#pragma once
+
 //
 // The lexer transforms input characters into distinct tokens
 // All whitespace is ignored and is not meaningful to the output
@@ -5,15 +7,22 @@
 
 #include "token.hpp"
 
-#include <unordered_map>
-
 class file;
+class input_stream;
 
 class lexer {
 
 public:
   lexer(symbol_table& syms, const file& f);
 
+  // Lexes the bytes [first, last) of the text of src, which must start and
+  // end on token boundaries. Locations are still offsets from text.
+  lexer(symbol_table& syms, const source& src, const char* text,
+        std::size_t first, std::size_t last);
+
+  // Lexes input pulled from s one window at a time.
+  lexer(symbol_table& syms, input_stream& s);
+
   token operator()() { return scan(); }
 
   token scan();
@@ -21,44 +30,64 @@ public:
   // If at the end of the file or not
   bool eof() const;
 
-  // Either peek 1 character with no params, or peek n chars
-  char peek() const;
-  char peek(int n) const;
+  // Either peek 1 character with no params, or peek n chars. Peeking past
+  // the end of a streamed window pulls in more input.
+  char peek();
+  char peek(int n);
 
 
 private:
+  lexer(symbol_table& syms, const source& src, const char* first,
+        const char* last, input_stream* s);
+
+  // Refills the window of a streamed input
+  bool underflow();
+
   // Either accept 1 character with no params, or accept n chars
   char accept();
   char accept(int n);
 
 
-  char ignore();
-
   // Make it easy to skip past certain types of whitespace
   void skip_space();
-  void skip_newline();
   void skip_comment();
 
   // Fucntions that return a token based on what is accepted
-  token lex_punctuator(token n);
-  token lex_relational_op(int len, relational_op op);
-  token lex_arithmetic_op(arithmetic_op op);
-  token lex_bitwise_op(int len, bitwise_op op);
-  token lex_conditional_op();
-  token lex_assignment_op();
+  token lex_fixed(unsigned state);
   token lex_word();
-  token lex_number();
+  token lex_decimal_number();
+  token lex_floating_point_number();
   token lex_binary_number();
   token lex_hexadecimal_number();
   token lex_character();
   token lex_string();
 
-  // gives back the unescaped character rather than a token
-  char scan_escape_sequence();
+  // Unescapes one character into c, or returns false with the error in e
+  bool scan_escape_sequence(char& c, lex_error& e);
 
-  // Keeps track of the current position
+  // Makes an error token, skipping the rest of a bad literal
+  token recover(lex_error e, char close);
+
+  symbol_table& m_syms;
+
+  // Keeps track of the current position. The input is terminated by a NUL
+  // sentinel at m_last.
   const char* m_first;
   const char* m_last;
 
-  std::unordered_map<symbol, token> m_res_words;
+  // Start of the token being lexed. A refill keeps the window from here on.
+  const char* m_token_first;
+
+  // The source of a streamed input, or null for a file
+  input_stream* m_stream;
+
+  // Locations are byte offsets: m_window is at offset m_base in the source.
+  const char* m_window;
+  std::uint32_t m_base;
+  std::uint16_t m_source;
+
+  location m_token_loc;
+
+  // Unescaped string literals
+  arena m_strings;
 };
@@ -0,0 +1,56 @@
+#include "location.hpp"
+#include "skip.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+void line_map::add(const char* first, const char* last, std::uint32_t base) {
+  mark_newlines(first, last, base, m_starts);
+}
+
+line_column line_map::resolve(std::uint32_t offset) const {
+  auto iter = std::upper_bound(m_starts.begin(), m_starts.end(), offset);
+  unsigned line = iter - m_starts.begin();
+  return {line, offset - *(iter - 1) + 1};
+}
+
+
+// -------------------------------------
+// Source registry
+// -------------------------------------
+static std::mutex registry_lock;
+static std::vector<const source*> registry(1, nullptr);
+static std::vector<std::uint16_t> free_ids;
+
+source::source() {
+  std::lock_guard<std::mutex> guard(registry_lock);
+  if (!free_ids.empty()) {
+    m_id = free_ids.back();
+    free_ids.pop_back();
+    registry[m_id] = this;
+    return;
+  }
+  if (registry.size() > UINT16_MAX)
+    throw std::length_error("too many source files");
+  m_id = registry.size();
+  registry.push_back(this);
+  // So that the destructor never allocates
+  free_ids.reserve(registry.size());
+}
+
+source::~source() {
+  std::lock_guard<std::mutex> guard(registry_lock);
+  registry[m_id] = nullptr;
+  free_ids.push_back(m_id);
+}
+
+const source* source::get(std::uint16_t id) {
+  std::lock_guard<std::mutex> guard(registry_lock);
+  return id < registry.size() ? registry[id] : nullptr;
+}
+
+line_column resolve(location loc) {
+  if (const source* src = source::get(loc.source))
+    return src->resolve(loc.offset);
+  return {0, 0};
+}
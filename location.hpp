@@ -0,0 +1,73 @@
+#pragma once
+
+//
+// Source locations
+//
+// A location is just a byte offset and the id of the source it is in.
+// Lines and columns are not tracked while lexing; they are computed from a
+// table of line starts when a diagnostic or debug-info consumer asks.
+//
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct location {
+  location() : offset(0), source(0) {}
+  location(std::uint16_t src, std::uint32_t off) : offset(off), source(src) {}
+
+  std::uint32_t offset;
+  std::uint16_t source;
+};
+
+// Both are 1-based.
+struct line_column {
+  unsigned line;
+  unsigned column;
+};
+
+// The offsets at which each line of a text starts.
+class line_map {
+  std::vector<std::uint32_t> m_starts;
+
+public:
+  line_map() : m_starts(1, 0) {}
+
+  // Records the lines started by newlines in [first, last), where first is
+  // at offset base.
+  void add(const char* first, const char* last, std::uint32_t base);
+
+  line_column resolve(std::uint32_t offset) const;
+};
+
+// Something locations can point into. Each source gets an id when it is
+// constructed, and its id is reused after it is destroyed; id 0 is never
+// used. Ids are 16 bits so that they pack into a token, which limits a
+// process to 65535 sources alive at once.
+class source {
+public:
+  virtual ~source();
+
+  std::uint16_t getId() const { return m_id; }
+
+  virtual const std::string& getName() const = 0;
+  virtual line_column resolve(std::uint32_t offset) const = 0;
+
+  // Returns the live source with the given id, or null.
+  static const source* get(std::uint16_t id);
+
+protected:
+  source();
+
+  source(const source&) = delete;
+  source& operator=(const source&) = delete;
+
+private:
+  std::uint16_t m_id;
+};
+
+// Returns the line and column of loc, or 0:0 if its source is gone. A
+// location kept after its source is destroyed may instead resolve against
+// a later source that reuses the id.
+line_column resolve(location loc);
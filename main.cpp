@@ -10,6 +10,7 @@
 
 #include "lexer.hpp"
 #include "file.hpp"
+#include "parser.hpp"
 
 int main() {
   file source_file("test.mc");
@@ -20,7 +21,8 @@ int main() {
   // while (token tok = lex())
   //   std::cout << tok << '\n';
 
-  parser p(syms, input);
-  p.parse_declaration();
+  ast_context ast;
+  parser p(syms, ast, source_file);
+  p.parseProgram();
 
 }
@@ -0,0 +1,81 @@
+#include "parallel_lex.hpp"
+#include "lexer.hpp"
+#include "file.hpp"
+#include "skip.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <thread>
+
+// Chunks smaller than this are not worth a task
+static constexpr std::size_t min_chunk_size = 256 * 1024;
+
+// Several chunks per thread, so a thread that finishes early takes more.
+static constexpr std::size_t chunks_per_thread = 4;
+
+// Returns the chunk boundaries as offsets, from 0 to f.size().
+static std::vector<std::size_t> split(const file& f, std::size_t n) {
+  std::vector<std::size_t> bounds(1, 0);
+  for (std::size_t i = 1; i < n; ++i) {
+    std::size_t target = f.size() / n * i;
+    if (target <= bounds.back())
+      continue;
+    const char* nl = find_newline(f.begin() + target, f.end());
+    if (nl == f.end())
+      break;
+    bounds.push_back(nl + 1 - f.begin());
+  }
+  if (bounds.size() == 1 || bounds.back() != f.size())
+    bounds.push_back(f.size());
+  return bounds;
+}
+
+void lex_parallel(symbol_table& syms, const file& f, token_buffer& out,
+                  unsigned threads) {
+  assert(out.empty());
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  assert(threads == 1 || syms.isConcurrent());
+
+  std::size_t chunks = std::min(threads * chunks_per_thread,
+                                f.size() / min_chunk_size + 1);
+  std::vector<std::size_t> bounds = split(f, chunks);
+  chunks = bounds.size() - 1;
+  threads = std::min<std::size_t>(threads, chunks);
+
+  std::deque<token_buffer> bufs;
+  for (std::size_t i = 0; i < chunks; ++i)
+    bufs.emplace_back(syms, f.getId(), f.begin());
+  std::vector<std::exception_ptr> errors(chunks);
+
+  std::atomic<std::size_t> next(0);
+  auto work = [&] {
+    std::size_t i;
+    while ((i = next.fetch_add(1, std::memory_order_relaxed)) < chunks) {
+      try {
+        lexer lex(syms, f, f.begin(), bounds[i], bounds[i + 1]);
+        while (token tok = lex.scan())
+          bufs[i].push_back(tok);
+      }
+      catch (...) {
+        errors[i] = std::current_exception();
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads; ++t)
+    pool.emplace_back(work);
+  work();
+  for (std::thread& t : pool)
+    t.join();
+
+  for (std::size_t i = 0; i < chunks; ++i) {
+    if (errors[i])
+      std::rethrow_exception(errors[i]);
+    out.append(bufs[i]);
+  }
+  out.push_back({tok_eof, location(f.getId(), f.size())});
+}
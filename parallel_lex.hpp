@@ -0,0 +1,24 @@
+#pragma once
+
+//
+// Lexing one file on several threads
+//
+// No token spans a line break. Comments end at a newline, and a character
+// or string literal that reaches one is an error. So the input is cut just
+// after newlines into chunks, which are lexed independently and then
+// joined. The tokens are the same as from a single lexer, error tokens
+// included: a literal that runs to the edge of its chunk hits the newline
+// there and fails as it would have sequentially, and recovery from a bad
+// literal never skips past a newline. Any exception is rethrown from the
+// earliest chunk that failed.
+//
+
+#include "token_buffer.hpp"
+
+class file;
+
+// Lexes all of f into out, which must be empty, ending with tok_eof. A
+// threads of 0 means one per core. The symbol table must be concurrent
+// unless threads is 1.
+void lex_parallel(symbol_table& syms, const file& f, token_buffer& out,
+                  unsigned threads = 0);
@@ -0,0 +1,161 @@
+//
+// A differential check of lex_parallel against the sequential lexer
+//
+//   g++ -std=c++17 -O2 -pthread parallel_lex_check.cpp arena.cpp
+//     diagnostic.cpp file.cpp lexer.cpp location.cpp parallel_lex.cpp
+//     skip.cpp stream.cpp symbol.cpp token.cpp token_buffer.cpp
+//   ./a.out [seeds]
+//
+// Each input is a few megabytes of generated lines that are dense with
+// the cases a chunk edge could break: comments holding quotes, strings
+// with escapes, literals left open at the end of a line, bad characters,
+// and blank and empty lines. The chunk edges fall after whichever
+// newlines are nearest the split points, so every kind of line ends up
+// next to one as the seed and thread count vary. The tokens from every
+// thread count must match the sequential lexer's in name, offset and
+// payload. Nothing here is linked into the compiler.
+//
+
+#include "file.hpp"
+#include "lexer.hpp"
+#include "parallel_lex.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <unistd.h>
+
+namespace {
+
+// Lines that lex to something unusual, each ending just before a newline
+const char* const tricky_lines[] = {
+  "# a comment with \"a quote and 'a tick",
+  "var s = \"a string # with a hash\";",
+  "var e = \"escapes \\\" \\\\ \\n \\t\";",
+  "var u = \"left open",
+  "var v = \"open after an escape \\",
+  "var c = 'x'; var d = '\\n'; var q = '\\'';",
+  "var w = 'ab';",
+  "var z = '",
+  "var y = '';",
+  "var b = 0b1011 + 0x7fFF * 42 - 3.25e2 / 1.5;",
+  "var big = 99999999999999999999999;",
+  "if a <= b and not c or d != e { x = y << 2 >> 1 & 3 | 4 ^ 5; }",
+  "def f(a: int, b: float) -> bool { return true; }",
+  "@ $ ` stray characters",
+  "    \t  ",
+  "",
+  "identifier_with_digits_123 _leading another",
+  "x = a ? b : c; # trailing comment \"",
+};
+
+constexpr std::size_t num_tricky = sizeof tricky_lines / sizeof *tricky_lines;
+
+std::string makeInput(unsigned seed, std::size_t bytes) {
+  std::string text;
+  std::uint32_t x = 2463534242u ^ (seed * 2654435761u);
+  while (text.size() < bytes) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    text += tricky_lines[x % num_tricky];
+    text += '\n';
+  }
+  // The last line has no newline, so the last chunk ends at the end of
+  // the file rather than after one.
+  text += "var end = \"unterminated at end of file";
+  return text;
+}
+
+bool sameToken(const token& a, const token& b) {
+  if (a.getName() != b.getName() ||
+      a.getLocation().offset != b.getLocation().offset)
+    return false;
+  switch (a.getName()) {
+    case tok_relational_op:
+      return a.getRelationalOperator() == b.getRelationalOperator();
+    case tok_arithmetic_op:
+      return a.getArithmeticOperator() == b.getArithmeticOperator();
+    case tok_bitwise_op:
+      return a.getBitwiseOperator() == b.getBitwiseOperator();
+    case tok_logical_op:
+      return a.getLogicalOperator() == b.getLogicalOperator();
+    case tok_identifier:
+      return a.getIdentifier() == b.getIdentifier();
+    case tok_binary_integer:
+    case tok_decimal_integer:
+    case tok_hexadecimal_integer:
+      return a.getInteger() == b.getInteger();
+    case tok_floating_point:
+      return a.getFloatingPoint() == b.getFloatingPoint();
+    case tok_boolean:
+      return a.getBoolean() == b.getBoolean();
+    case tok_character:
+      return a.getChar() == b.getChar();
+    case tok_string:
+      return a.getString() == b.getString();
+    case tok_type_specifier:
+      return a.getTypeSpecifier() == b.getTypeSpecifier();
+    case tok_error:
+      return a.getError() == b.getError();
+    default:
+      return true;
+  }
+}
+
+// Compares the tokens of f lexed on the given number of threads with
+// those of the sequential lexer, and reports the first difference.
+bool check(const file& f, symbol_table& syms, const token_buffer& expect,
+           unsigned threads) {
+  token_buffer got(syms, f.getId(), f.begin());
+  lex_parallel(syms, f, got, threads);
+  std::size_t n = std::min(expect.size(), got.size());
+  for (std::size_t i = 0; i != n; ++i) {
+    if (!sameToken(expect[i], got[i])) {
+      std::fprintf(stderr, "%s, %u threads: token %zu at offset %u differs\n",
+                   f.getPath().c_str(), threads, i, expect.getOffset(i));
+      return false;
+    }
+  }
+  if (expect.size() != got.size()) {
+    std::fprintf(stderr, "%s, %u threads: %zu tokens, expected %zu\n",
+                 f.getPath().c_str(), threads, got.size(), expect.size());
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  unsigned seeds = argc > 1 ? std::atoi(argv[1]) : 8;
+  bool ok = true;
+  for (unsigned seed = 0; seed != seeds; ++seed) {
+    std::string text = makeInput(seed, (2 + seed % 3) << 20);
+    char path[] = "/tmp/parallel-lex-XXXXXX";
+    int fd = ::mkstemp(path);
+    if (fd < 0 || ::write(fd, text.data(), text.size()) != ssize_t(text.size())) {
+      std::fprintf(stderr, "cannot write %s\n", path);
+      return 2;
+    }
+    ::close(fd);
+
+    {
+      file f(path);
+      symbol_table syms(symbol_table::concurrent);
+      token_buffer expect(syms, f.getId(), f.begin());
+      lexer lex(syms, f);
+      while (token tok = lex.scan())
+        expect.push_back(tok);
+      expect.push_back({tok_eof, location(f.getId(), f.size())});
+
+      for (unsigned threads : {1u, 2u, 3u, 4u, 7u, 8u})
+        ok = check(f, syms, expect, threads) && ok;
+    }
+    ::unlink(path);
+  }
+  std::printf(ok ? "lex_parallel matches the sequential lexer\n"
+                 : "lex_parallel differs from the sequential lexer\n");
+  return ok ? 0 : 1;
+}
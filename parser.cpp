@@ -4,30 +4,71 @@
 // Yet to implement - most of expression / declaration functions
 
 #include "parser.hpp"
+#include "file.hpp"
+#include "parallel_lex.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
 
+parser::parser(symbol_table &syms, ast_context &ast, const file &f,
+               lex_mode mode)
+    : m_lex(syms, f), m_mode(mode), m_stop(false),
+      m_buf(syms, f.getId(), f.begin()), m_pos(0), m_panic(false),
+      m_defer(false), m_globals(0), m_program(nullptr), m_act(ast) {
+  if (m_mode == lex_mode::pipelined) {
+    if (!syms.isConcurrent())
+      throw std::invalid_argument(
+          "pipelined lexing needs a concurrent symbol table");
+    m_ring.reset(new pipe_ring());
+    m_producer = std::thread(&parser::produce, this);
+  }
+  if (!isPrelexed()) {
+    try {
+      fetch();
+    } catch (...) {
+      stop();
+      throw;
+    }
+    return;
+  }
+  // Only a concurrent table can be shared by several lexers
+  if (m_mode == lex_mode::parallel)
+    lex_parallel(syms, f, m_buf, syms.isConcurrent() ? 0 : 1);
+  else {
+    token tok;
+    do {
+      tok = m_lex.scan();
+      m_buf.push_back(tok);
+    } while (tok);
+  }
+  m_buf.takeErrors(m_diags);
+}
+
 inline token_name parser::lookahead() {
+  if (isPrelexed())
+    return m_buf.getName(m_pos);
   assert(!m_tok.empty());
   return m_tok.front().getName();
 }
 
+// The buffer ends with tok_eof, which is repeated for any lookahead past it.
 inline token_name parser::lookahead(int n) {
-  if (n < m_tok.size())
-    return m_tok[n].getName();
-  n = n - m_tok.size() + 1;
-  while (n != 0) {
+  if (isPrelexed())
+    return m_buf.getName(std::min(m_pos + n, m_buf.size() - 1));
+  while (m_tok.size() <= std::size_t(n))
     fetch();
-    n--;
-  }
-  return m_tok.back().getName();
+  return m_tok[n].getName();
 }
 
-token parser::match(tokenName n) {
+// On a mismatch the token is left for synchronize() to skip, and an empty
+// token is returned.
+token parser::match(token_name n) {
   if (lookahead() == n)
     return accept();
+  error(std::string("expected ") + toString(n));
+  return {};
 }
 
 token parser::matchIf(token_name n) {
@@ -37,125 +78,146 @@ token parser::matchIf(token_name n) {
     return {};
 }
 
-token parser::matchIfLogicalOr() {
-  if (lookahead() == tok_logical_op)
-    if (peek().getLogicalOperator() == logical_or)
-      return accept;
-  return {};
+token parser::accept() {
+  token tok = peek();
+  if (isPrelexed()) {
+    if (m_pos + 1 < m_buf.size())
+      ++m_pos;
+    return tok;
+  }
+  // Like the buffer, the lookahead stays on tok_eof
+  if (!tok)
+    return tok;
+  m_tok.pop_front();
+  if (m_tok.empty())
+    fetch();
+  return tok;
 }
 
-token parser::matchIfLogicalAnd() {
-  if (lookahead() == tok_logical_op)
-    if (peek().getLogicalOperator() == logical_and)
-      return accept;
-  return {};
+token parser::peek() {
+  if (isPrelexed())
+    return m_buf[m_pos];
+  assert(!m_tok.empty());
+  return m_tok.front();
 }
 
-token parser::matchIfBitwiseOr() {
-  if (lookahead() == token_bitwise_op)
-    if (peek().getBitwiseOperator() == op_ior)
-      return accept();
-  return {};
-}
+parser::~parser() { stop(); }
 
-token parser::matchIfBitwiseXor() {
-  if (lookahead() == token_bitwise_op)
-    if (peek().getBitwiseOperator() == op_xor)
-      return accept();
-  return {};
+void parser::stop() {
+  if (m_producer.joinable()) {
+    m_stop.store(true, std::memory_order_relaxed);
+    m_producer.join();
+  }
 }
 
-token parser::matchIfBitwiseAnd() {
-  if (lookahead() == token_bitwise_op)
-    if (peek().getBitwiseOperator() == op_and)
-      return accept();
-  return {};
+std::size_t parser::mark() {
+  if (isPrelexed())
+    return m_pos;
+  return m_tok.mark();
 }
 
-token parser::matchIfEquality() {
-  if (lookahead() == tok_relational_op) {
-    switch(peek().getRelationalOperator() {
-    case op_eq:
-      return accept();
-    case op_ne:
-      return accept();
-    default:
-      return {};
-    }
-  }
-  return {};
+void parser::rewind(std::size_t pos) {
+  if (isPrelexed())
+    m_pos = pos;
+  else
+    m_tok.rewind(pos);
 }
 
-token parser::matchIfRelational() {
-  if (lookahead() == tok_relational_op) {
-    switch (peek().getRelationOperator()) {
-    case op_lt:
-    case op_gt:
-    case op_le:
-    case op_ge:
-      return accept();
-    default:
-      return {};
-    }
-  }
-  return {};
+void parser::release() {
+  if (!isPrelexed())
+    m_tok.release();
 }
 
-token parser::matchIfShift() {
-  if (lookahead() == tok_bitwise_op) {
-    switch (peek().getBitwiseOperator()) {
-    case op_shl:
-    case op_shr:
-      return accept();
-    default:
-      return {};
-    }
-  }
-  return {};
+// Only the first error before the parser synchronizes is reported; the
+// rest are usually caused by it.
+void parser::error(const std::string &msg) {
+  if (m_panic)
+    return;
+  m_diags.push_back({peek().getLocation(), msg});
+  m_panic = true;
 }
 
-token parser::matchIfAdditive() {
-  if (lookahead() == tok_arithmetic_op) {
-    switch (peek().getArithmeticOperator()) {
-    case op_add:
-    case op_sub:
-      return accept();
-    default:
-      return {};
+// Skips to a point where parsing can resume: past a ';', or before a '}'
+// that closes an enclosing block, the start of a declaration, or the end
+// of input. Braced groups are skipped whole, since what they contain
+// belongs to the construct that failed.
+void parser::synchronize() {
+  unsigned depth = 0;
+  while (true) {
+    token_name n = lookahead();
+    if (n == tok_eof)
+      break;
+    if (n == tok_left_brace)
+      ++depth;
+    else if (n == tok_right_brace) {
+      if (depth == 0)
+        break;
+      if (--depth == 0) {
+        accept();
+        break;
+      }
+    } else if (depth == 0) {
+      if (n == tok_semicolon) {
+        accept();
+        break;
+      }
+      if (n == kw_def || n == kw_let || n == kw_var)
+        break;
     }
+    accept();
   }
-  return {};
+  m_panic = false;
 }
 
-token parser::matchIfMultiplicative() {
-  if (lookahead() == tok_arithmetic_op) {
-    switch (peek().getArithmeticOperator()) {
-    case op_mul:
-    case op_quo:
-    case op_rem:
-      return accept();
-    default:
-      return {};
-    }
+// Lexical errors are recorded and skipped; the parser never sees them.
+// Once the lexer has reached the end, tok_eof is repeated.
+void parser::fetch() {
+  if (!m_tok.empty() && !m_tok.back()) {
+    m_tok.push_back(m_tok.back());
+    return;
   }
-  return {};
-}
 
-token parser::accept() {
-  token tok = peek();
-  m_tok.popFront();
-  if (m_tok.empty())
-    fetch();
-  return tok;
+  token tok;
+  do {
+    if (m_mode == lex_mode::pipelined) {
+      while (!m_ring->try_pop(tok))
+        std::this_thread::yield();
+      if (!tok && m_error)
+        std::rethrow_exception(m_error);
+    } else
+      tok = m_lex.scan();
+
+    if (tok.getName() == tok_error)
+      m_diags.push_back({tok.getLocation(), toString(tok.getError())});
+  } while (tok.getName() == tok_error);
+  m_tok.push_back(tok);
+}
+
+// Runs on the lexer thread in pipelined mode, until the end of the input
+// or until the parser is destroyed.
+void parser::produce() {
+  token tok;
+  do {
+    try {
+      tok = m_lex.scan();
+    } catch (...) {
+      m_error = std::current_exception();
+      tok = token();
+    }
+    while (!m_ring->try_push(tok)) {
+      if (m_stop.load(std::memory_order_relaxed))
+        return;
+      std::this_thread::yield();
+    }
+  } while (tok);
 }
 
-token parser::peek() {
-  assert(!m_tok.empty());
-  return m_tok.front();
+// Parenthesized types nest through here, so this is bounded like
+// parseExpression.
+type *parser::parseType() {
+  return m_stack([this] { return parseBasicType(); });
 }
 
-type *parser::parseType() { return parseBasicType(); }
-
 type *parser::parseBasicType() {
   switch (lookahead()) {
   case tok_type_specifier:
@@ -167,178 +229,217 @@ type *parser::parseBasicType() {
     return t;
   }
   default:
-    throw std::runtime_error("Expected basic type");
+    error("expected a type");
+    return nullptr;
+  }
+}
+
+// Binary operators, by precedence from loosest to tightest
+enum binary_prec : unsigned char {
+  prec_none,
+  prec_logical_or,
+  prec_logical_and,
+  prec_bitwise_or,
+  prec_bitwise_xor,
+  prec_bitwise_and,
+  prec_equality,
+  prec_relational,
+  prec_shift,
+  prec_additive,
+  prec_multiplicative,
+};
+
+// The precedence of each operator, indexed by its token name (counting from
+// tok_relational_op) and then its sub-operator.
+static constexpr binary_prec binary_table[4][6] = {
+    // relational_op: eq, ne, lt, gt, le, ge
+    {prec_equality, prec_equality, prec_relational, prec_relational,
+     prec_relational, prec_relational},
+    // arithmetic_op: add, sub, mul, quo, mod
+    {prec_additive, prec_additive, prec_multiplicative, prec_multiplicative,
+     prec_multiplicative},
+    // bitwise_op: and, ior, xor, shl, shr, not
+    {prec_bitwise_and, prec_bitwise_or, prec_bitwise_xor, prec_shift,
+     prec_shift, prec_none},
+    // logical_op: and, or, not
+    {prec_logical_and, prec_logical_or, prec_none},
+};
+
+static_assert(tok_arithmetic_op == tok_relational_op + 1 &&
+                  tok_bitwise_op == tok_relational_op + 2 &&
+                  tok_logical_op == tok_relational_op + 3,
+              "binary_table rows follow the token names");
+
+static binary_prec getPrecedence(const token &tok) {
+  switch (tok.getName()) {
+  case tok_relational_op:
+    return binary_table[0][tok.getRelationalOperator()];
+  case tok_arithmetic_op:
+    return binary_table[1][tok.getArithmeticOperator()];
+  case tok_bitwise_op:
+    return binary_table[2][tok.getBitwiseOperator()];
+  case tok_logical_op:
+    return binary_table[3][tok.getLogicalOperator()];
+  default:
+    return prec_none;
   }
 }
 
-expression *parser::parseExpression() { return parseAssignmentExpression(); }
+// Every path by which expressions nest comes back through here, so this is
+// where the recursion is bounded (see stack.hpp).
+expression *parser::parseExpression() {
+  return m_stack([this] { return parseAssignmentExpression(); });
+}
 
 expression *parser::parseAssignmentExpression() {
   expression *e1 = parseConditionalExpression();
-  if (matchIf(tok_assignment_op)) {
-    expression *e2 = parseAssignmentExpression();
+  if (!m_panic && matchIf(tok_assignment_op)) {
+    expression *e2 = parseExpression();
+    if (m_panic)
+      return m_act.onErrorExpression();
     return m_act.onAssignmentExpression(e1, e2);
   }
   return e1;
 }
 
 expression *parser::parseConditionalExpression() {
-  expression *e1 = parseLogicalOrExpression();
-  if (matchIf(tok_assignment_op)) {
-    expression *e2 = parseAssignmentExpression();
+  expression *e1 = parseBinaryExpression(prec_logical_or);
+  if (!m_panic && matchIf(tok_assignment_op)) {
+    expression *e2 = parseExpression();
+    if (m_panic)
+      return m_act.onErrorExpression();
     return m_act.onAssignmentExpression(e1, e2);
   }
   return e1;
 }
 
-expression *parser::parseLogicalOrExpression() {
-  expression *e1 = parseLogicalAndExpression();
-  while (matchIfLogicalOr()) {
-    expression *e2 = parseLogicalAndExpression();
-    e1 = m_act.onLogicalOrExpression(e1, e2);
-  }
-  return e1;
-}
-
-expression *parser::parseLogicalAndExpression() {
-  expression *e1 = parseBitwiseOrExpression();
-  while (matchIfLogicalAnd()) {
-    expression *e2 = parseBitwiseOrExpression();
-    e1 = m_act.onLogicalAndExpression(e1, e2);
-  }
-  return e1;
-}
-
-expression *parser::parseBitwiseOrExpression() {
-  expression *e1 = parseBitwiseXorExpression();
-  while (matchIfBitwiseOr()) {
-    expression *e2 = parseBitwiseXorExpression();
-    e1 = m_act.onBitwiseOrExpression(e1, e2);
-  }
-  return e1;
-}
-
-expression *parser::parseBitwiseXorExpression() {
-  expression *e1 = parseBitwiseAndExpression();
-  while (matchIfBitwiseXor()) {
-    expression *e2 = parseBitwiseXorExpression();
-    e1 = m_act.onBitwiseXorExpression(e1, e2);
-  }
-  return e1;
-}
-
-expression *parser::parseBitwiseAndExpression() {
-  expression *e1 = parseEqualityExpression();
-  while (matchIfBitwiseAnd()) {
-    expression *e2 = parseEqualityExpression();
-    e1 = m_act.onBitwiseAndExpression(e1, e2);
-  }
-  return e1;
-}
-
-expression *parser::parseEqualityExpression() {
-  expression *e1 = parseRelationalExpression();
-  while (token tok = matchIfEquality()) {
-    expression *e2 = parseRelationalExpression();
-    e1 = m_act.onEqualityExpression(tok, e1, e2);
-  }
-  return e1;
-}
-
-expression *parser::parseRelationalExpression() {
-  expression *e1 = parseShiftExpression();
-  while (token tok = matchIfRelational()) {
-    expression *e2 = parseShiftExpression();
-    e1 = m_act.onRelationalExpression(tok, e1, e2);
-  }
-  return e1;
-}
-
-expression *parser::parseShiftExpression() {
-  expression *e1 = parseAdditiveExpression();
-  while (token tok = matchIfShift()) {
-    expression *e2 = parseAdditiveExpression();
-    e1 = m_act.onShiftExpression(tok, e1, e2);
-  }
-  return e1;
-}
-
-expression *parser::parseAdditiveExpression() {
-  expression *e1 = parseMultiplicativeExpression();
-  while (token tok = matchIfAdditive()) {
-    expression *e2 = parseMultiplicativeExpression();
-    e1 = m_act.onAdditiveExpression(tok, e1, e2);
+static bool isOperator(token_name n) {
+  return n >= tok_relational_op && n <= tok_logical_op;
+}
+
+expression *parser::onBinaryExpression(unsigned prec, token op,
+                                       expression *e1, expression *e2) {
+  switch (prec) {
+  case prec_logical_or:
+    return m_act.onLogicalOrExpression(e1, e2);
+  case prec_logical_and:
+    return m_act.onLogicalAndExpression(e1, e2);
+  case prec_bitwise_or:
+    return m_act.onBitwiseOrExpression(e1, e2);
+  case prec_bitwise_xor:
+    return m_act.onBitwiseXorExpression(e1, e2);
+  case prec_bitwise_and:
+    return m_act.onBitwiseAndExpression(e1, e2);
+  case prec_equality:
+    return m_act.onEqualityExpression(op, e1, e2);
+  case prec_relational:
+    return m_act.onRelationalExpression(op, e1, e2);
+  case prec_shift:
+    return m_act.onShiftExpression(op, e1, e2);
+  case prec_additive:
+    return m_act.onAdditiveExpression(op, e1, e2);
+  case prec_multiplicative:
+    return m_act.onMultiplicativeExpression(op, e1, e2);
+  default:
+    throw std::logic_error("invalid binary operator");
   }
-  return e1;
 }
 
-expression *parser::parseMultiplicativeExpression() {
+// Parses the binary operators from logical-or down to multiplicative by
+// precedence climbing, instead of one function per level. The operands are
+// cast expressions, and only operators that bind at least as tightly as
+// min are taken here. All of them are left-associative.
+expression *parser::parseBinaryExpression(unsigned min) {
   expression *e1 = parseCastExpression();
-  while (token tok = matchIfMultiplicative()) {
-    expression *e2 = parseCastExpression();
-    e1 = m_act.onMultiplicativeExpression(tok, e1, e2);
+  while (!m_panic && isOperator(lookahead())) {
+    token op = peek();
+    binary_prec prec = getPrecedence(op);
+    if (prec == prec_none || prec < min)
+      break;
+    accept();
+    expression *e2 = parseBinaryExpression(prec + 1);
+    if (m_panic)
+      return m_act.onErrorExpression();
+    e1 = onBinaryExpression(prec, op, e1, e2);
   }
   return e1;
 }
 
 expression *parser::parseCastExpression() {
   expression *e = parseUnaryExpression();
-  if (matchIf(kw_as)) {
+  if (!m_panic && matchIf(kw_as)) {
     type *t = parseType();
+    if (m_panic)
+      return m_act.onErrorExpression();
     return m_act.onCastExpression(e, t);
   }
   return e;
 }
 
-expression *parser::parseUnaryExpression() {
-  token op;
-  switch (lookahead()) {
+static bool isUnaryOperator(const token &tok) {
+  switch (tok.getName()) {
   case tok_arithmetic_op:
-    switch (peek().getArithmeticOperator()) {
+    switch (tok.getArithmeticOperator()) {
     case op_add:
     case op_sub:
     case op_mul:
-      op = accept();
-      break;
+      return true;
     default:
-      break;
+      return false;
     }
   case tok_bitwise_op:
-    switch (peek().getBitwiseOperator()) {
+    switch (tok.getBitwiseOperator()) {
     case op_not:
     case op_and:
-      op = accept();
-      break;
+      return true;
     default:
-      break;
+      return false;
     }
-  case tok_logical_operator:
-    if (peek().getLogicalOperator() == logical_not)
-      op = accept();
-    break;
+  case tok_logical_op:
+    return tok.getLogicalOperator() == logical_not;
   default:
-    break;
+    return false;
   }
+}
 
-  if (op) {
-    expression *e = parseUnaryExpression();
-    return m_act.on_unary_expression();
-  }
+// A run of prefix operators is collected first and applied innermost
+// first, so that a long run does not recurse. m_prefix is shared by nested
+// calls; each uses only the operators it pushed.
+expression *parser::parseUnaryExpression() {
+  std::size_t base = m_prefix.size();
+  while (isUnaryOperator(peek()))
+    m_prefix.push_back(accept());
 
-  return parsePostfixExpression();
+  expression *e = parsePostfixExpression();
+  if (m_panic) {
+    m_prefix.resize(base);
+    return e;
+  }
+  while (m_prefix.size() > base) {
+    e = m_act.onUnaryExpression(m_prefix.back(), e);
+    m_prefix.pop_back();
+  }
+  return e;
 }
 
 expression *parser::parsePostfixExpression() {
   expression *e = parsePrimaryExpression();
-  while (true) {
+  while (!m_panic) {
     if (matchIf(tok_left_paren)) {
-      expr_list args = parseArgumentList();
+      scratch_list<expression *> args(m_expr_stack);
+      if (lookahead() != tok_right_paren)
+        parseArgumentList(args);
       match(tok_right_paren);
-      e = m_act.onCallExpression(e, args);
+      if (m_panic)
+        return m_act.onErrorExpression();
+      e = m_act.onCallExpression(e, args.get());
     } else if (matchIf(tok_left_bracket)) {
-      expr_list args = parseArgumentList();
+      scratch_list<expression *> args(m_expr_stack);
+      parseArgumentList(args);
       match(tok_right_bracket);
-      e = m_act.onIndexExpression(e, args);
+      if (m_panic)
+        return m_act.onErrorExpression();
+      e = m_act.onIndexExpression(e, args.get());
     } else
       break;
   }
@@ -362,32 +463,40 @@ expression *parser::parsePrimaryExpression() {
     return m_act.onIdExpression(accept());
   case tok_left_paren: {
     match(tok_left_paren);
-    expression *e = parse_expression();
+    expression *e = parseExpression();
     match(tok_right_paren);
+    if (m_panic)
+      return m_act.onErrorExpression();
     return e;
   }
   default:
     break;
   }
 
-  throw std::runtime_error("Expected a primary expression");
+  error("expected an expression");
+  return m_act.onErrorExpression();
 }
 
-expr_list parser::parseArgumentList() {
-  expr_list args;
-  while (true) {
-    expression *e = parseExpression();
-    if (matchIf(tok_comma))
-      continue;
-    if (lookahead() == tok_right_paren)
-      break;
-    if (lookahead() == tok_right_brace)
-      break;
-  }
-  return args;
+void parser::parseArgumentList(scratch_list<expression *> &args) {
+  do
+    args.push_back(parseExpression());
+  while (!m_panic && matchIf(tok_comma));
 }
 
+// Statements nest through blocks, ifs and whiles, which all come back
+// through here. It is also where the parser recovers from a syntax error:
+// the rest of the statement is skipped and it is replaced by an error
+// node, so that the enclosing block carries on with the next statement.
 statement *parser::parseStatement() {
+  statement *s = m_stack([this] { return dispatchStatement(); });
+  if (m_panic) {
+    synchronize();
+    return m_act.onErrorStatement();
+  }
+  return s;
+}
+
+statement *parser::dispatchStatement() {
   switch (lookahead()) {
   case kw_if:
     return parseIfStatement();
@@ -398,7 +507,7 @@ statement *parser::parseStatement() {
   case kw_continue:
     return parseContinueStatement();
   case kw_return:
-    parseReturnStatement();
+    return parseReturnStatement();
   case kw_var:
   case kw_let:
   case kw_def:
@@ -412,27 +521,35 @@ statement *parser::parseStatement() {
 
 statement *parser::parseBlockStatement() {
   match(tok_left_brace);
+  if (m_panic)
+    return m_act.onErrorStatement();
   m_act.enterBlockScope();
   m_act.startBlock();
 
-  stmt_list ss;
+  scratch_list<statement *> ss(m_stmt_stack);
   if (lookahead() != tok_right_brace)
-    ss = parseStatementSequence();
+    parseStatementSequence(ss);
 
   m_act.finishBlock();
   m_act.leaveScope();
   match(tok_right_brace);
-  return m_act.onBlockStatement(ss);
+  if (m_panic)
+    return m_act.onErrorStatement();
+  return m_act.onBlockStatement(ss.get());
 }
 
-statement *parser::parserIfStatement() {
+statement *parser::parseIfStatement() {
   assert(lookahead() == kw_if);
   accept();
   match(tok_left_paren);
   expression *e = parseExpression();
   match(tok_right_paren);
+  if (m_panic)
+    return m_act.onErrorStatement();
   statement *t = parseStatement();
   match(kw_else);
+  if (m_panic)
+    return m_act.onErrorStatement();
   statement *f = parseStatement();
   return m_act.onIfStatement(e, t, f);
 }
@@ -442,7 +559,9 @@ statement *parser::parseWhileStatement() {
   accept();
   match(tok_left_paren);
   expression *e = parseExpression();
-  match(tok_left_paren);
+  match(tok_right_paren);
+  if (m_panic)
+    return m_act.onErrorStatement();
   statement *b = parseStatement();
   return m_act.onWhileStatement(e, b);
 }
@@ -451,6 +570,8 @@ statement *parser::parseBreakStatement() {
   assert(lookahead() == kw_break);
   accept();
   match(tok_semicolon);
+  if (m_panic)
+    return m_act.onErrorStatement();
   return m_act.onBreakStatement();
 }
 
@@ -458,71 +579,82 @@ statement *parser::parseContinueStatement() {
   assert(lookahead() == kw_continue);
   accept();
   match(tok_semicolon);
+  if (m_panic)
+    return m_act.onErrorStatement();
   return m_act.onContinueStatement();
 }
 
 statement *parser::parseReturnStatement() {
   assert(lookahead() == kw_return);
   accept();
-  expression *e = parserExpression();
+  expression *e = parseExpression();
   match(tok_semicolon);
+  if (m_panic)
+    return m_act.onErrorStatement();
   return m_act.onReturnStatement(e);
 }
 
 statement *parser::parseDeclarationStatement() {
   declaration *d = parseLocalDeclaration();
-  return m_act.onDeclarationStatement();
+  if (m_panic)
+    return m_act.onErrorStatement();
+  return m_act.onDeclarationStatement(d);
 }
 
 statement *parser::parseExpressionStatement() {
-  expression *e = parseEcpression();
+  expression *e = parseExpression();
   match(tok_semicolon);
+  if (m_panic)
+    return m_act.onErrorStatement();
   return m_act.onExpressionStatement(e);
 }
 
-statement *parser::parseStatementSequence() {
-  stmt_list ss;
-  while (true) {
-    statement *s = parseStatement();
-    ss.pushBack(s);
-    if (lookahead() == tok_right_brace)
-      break;
-  }
-  return ss;
+// Each statement either consumes a token or fails and synchronizes to a
+// ';' (consumed), a declaration (which is then parsed) or the end of the
+// block, so the loop always makes progress.
+void parser::parseStatementSequence(scratch_list<statement *> &ss) {
+  do
+    ss.push_back(parseStatement());
+  while (lookahead() != tok_right_brace && lookahead() != tok_eof);
 }
 
-declaration *parser::parse_declaration() {
+declaration *parser::parseDeclaration() {
   switch (lookahead()) {
-  default:
-    throw std::runtime_error("Expected a declaration");
   case kw_def: {
     token_name n = lookahead(2);
     if (n == tok_colon)
       return parseObjectDefinition();
     if (n == tok_left_paren)
       return parseFunctionDefinition();
-    throw std::runtime_error("Incorrect format");
-    break;
+    // synchronize() stops before a 'def', so skip this one or recovery
+    // would come back to it.
+    error("expected a declaration");
+    accept();
+    return m_act.onErrorDeclaration();
   }
   case kw_let:
   case kw_var:
     return parseObjectDefinition();
+  default:
+    break;
   }
-  return nullptr;
+  error("expected a declaration");
+  return m_act.onErrorDeclaration();
 }
 
 declaration *parser::parseLocalDeclaration() { return parseObjectDefinition(); }
 
 declaration *parser::parseObjectDefinition() {
-  swtich(lookahead()) {
-  default:
-    throw std::runtime_error("Expected an object definition");
+  switch (lookahead()) {
   case kw_def:
     return parseValueDefinition();
   case kw_let:
     return parseConstantDefinition();
   case kw_var:
     return parseVariableDefinition();
+  default:
+    error("expected an object definition");
+    return m_act.onErrorDeclaration();
   }
 }
 
@@ -532,12 +664,16 @@ declaration *parser::parseVariableDefinition() {
   token id = match(tok_identifier);
   match(tok_colon);
   type *t = parseType();
+  if (m_panic)
+    return m_act.onErrorDeclaration();
 
   declaration *d = m_act.onVariableDeclaration(id, t);
 
   match(tok_assignment_op);
   expression *e = parseExpression();
   match(tok_semicolon);
+  if (m_panic)
+    return m_act.onErrorDeclaration();
 
   return m_act.onVariableDefinition(d, e);
 }
@@ -548,12 +684,16 @@ declaration *parser::parseConstantDefinition() {
   token id = match(tok_identifier);
   match(tok_colon);
   type *t = parseType();
+  if (m_panic)
+    return m_act.onErrorDeclaration();
 
-  declaration *d = m_act.onVariableDeclaration(id, t);
+  declaration *d = m_act.onConstantDeclaration(id, t);
 
   match(tok_assignment_op);
   expression *e = parseExpression();
   match(tok_semicolon);
+  if (m_panic)
+    return m_act.onErrorDeclaration();
 
   return m_act.onConstantDefinition(d, e);
 }
@@ -564,12 +704,16 @@ declaration *parser::parseValueDefinition() {
   token id = match(tok_identifier);
   match(tok_colon);
   type *t = parseType();
+  if (m_panic)
+    return m_act.onErrorDeclaration();
 
-  declaration *d = m_act.onVariableDeclaration(id, t);
+  declaration *d = m_act.onValueDeclaration(id, t);
 
   match(tok_assignment_op);
   expression *e = parseExpression();
   match(tok_semicolon);
+  if (m_panic)
+    return m_act.onErrorDeclaration();
 
   return m_act.onValueDefiniton(d, e);
 }
@@ -581,56 +725,154 @@ declaration *parser::parseFunctionDefinition() {
 
   match(tok_left_paren);
   m_act.enterParameterScope();
-  decl_list params;
-  if (lookahead() != tok_right_paren)
-    params = parseParameterClause();
+  scratch_list<declaration *> params(m_decl_stack);
+  if (!m_panic && lookahead() != tok_right_paren)
+    parseParameterClause(params);
   m_act.leaveScope();
   match(tok_right_paren);
 
   match(tok_arrow_op);
 
   type *t = parseType();
+  if (m_panic)
+    return m_act.onErrorDeclaration();
 
-  declaration *d = m_act.onVariableDeclaration(id, t);
+  declaration *d = m_act.onFunctionDeclaration(id, params.get(), t);
 
-  statement *s = parseBlockStatement();
+  if (m_defer && isPrelexed() && lookahead() == tok_left_brace) {
+    std::size_t first = m_pos;
+    if (skipBlock()) {
+      m_deferred.emplace(d, deferred_body{first, m_globals + 1});
+      m_deferred_order.push_back(d);
+      return m_act.onFunctionDefiniton(d, nullptr);
+    }
+  }
+
+  statement *s = parseFunctionBody(d);
+  if (m_panic)
+    return m_act.onErrorDeclaration();
 
   return m_act.onFunctionDefiniton(d, s);
 }
 
-decl_list parser::parseParameterClause() { return parseParameterList(); }
-
-decl_list parser::parseParameterList() {
-  decl_list params;
-  while (true) {
-    params.pushBack(parseParameter());
-    if (matchIf(tok_comma))
-      continue;
-    else
+statement *parser::parseFunctionBody(declaration *d) {
+  m_act.enterFunctionScope(d);
+  statement *s = parseBlockStatement();
+  m_act.leaveFunctionScope();
+  return s;
+}
+
+// Moves past the '}' that matches the '{' at the current position, looking
+// only at the names in the buffer. Returns false, without moving, if the
+// braces are unbalanced; parsing the body then reports the error.
+bool parser::skipBlock() {
+  assert(lookahead() == tok_left_brace);
+  unsigned depth = 0;
+  for (std::size_t i = m_pos;; ++i) {
+    switch (m_buf.getName(i)) {
+    case tok_left_brace:
+      ++depth;
+      break;
+    case tok_right_brace:
+      if (--depth == 0) {
+        m_pos = i + 1;
+        return true;
+      }
+      break;
+    case tok_eof:
+      return false;
+    default:
       break;
+    }
   }
-  return params;
+}
+
+// The body is parsed in a global scope holding only the declarations
+// that came before it, as when it is parsed in place, so that deferring
+// does not change which programs are accepted.
+statement *parser::parseDeferredBody(declaration *d) {
+  auto iter = m_deferred.find(d);
+  if (iter == m_deferred.end())
+    return nullptr;
+  assert(m_program && "the program has not been parsed");
+
+  // Semantic errors are still thrown. Whether the body is parsed or not,
+  // put back the position and leave the scopes it opened, so that the
+  // parser can go on with other bodies.
+  struct restore {
+    parser &p;
+    std::size_t pos;
+    ~restore() {
+      p.m_pos = pos;
+      p.m_panic = false;
+      p.m_act.leaveAllScopes();
+    }
+  } guard{*this, m_pos};
+
+  m_pos = iter->second.pos;
+  std::size_t visible = iter->second.visible;
+  m_deferred.erase(iter);
+
+  m_act.enterProgramScope(m_program, visible);
+  statement *s = parseFunctionBody(d);
+
+  // The braces matched when the body was skipped, so any error was
+  // recovered from inside it.
+  assert(!m_panic);
+  m_act.onFunctionDefiniton(d, s);
+  return s;
+}
+
+// In source order, so that diagnostics come out in the same order on every
+// run.
+void parser::parseDeferredBodies() {
+  for (declaration *d : m_deferred_order)
+    parseDeferredBody(d);
+  m_deferred_order.clear();
+}
+
+void parser::parseParameterClause(scratch_list<declaration *> &params) {
+  parseParameterList(params);
+}
+
+void parser::parseParameterList(scratch_list<declaration *> &params) {
+  do
+    params.push_back(parseParameter());
+  while (!m_panic && matchIf(tok_comma));
 }
 
 declaration *parser::parseParameter() {
   token id = match(tok_identifier);
   match(tok_colon);
   type *t = parseType();
+  if (m_panic)
+    return m_act.onErrorDeclaration();
   return m_act.onParameterDeclaration(id, t);
 }
 
-decl_list parser::parseDeclarationSeq() {
-  decl_list ds;
+// A declaration with a syntax error is skipped up to the next one and
+// replaced by an error node. A '}' stops synchronize() but closes nothing
+// at this level, so it is skipped as well. A declaration that starts with
+// a keyword consumes it before failing, and synchronize() consumes any
+// other token, so the loop always makes progress.
+void parser::parseDeclarationSequence(scratch_list<declaration *> &ds) {
   while (peek()) {
     declaration *d = parseDeclaration();
-    ds.pushBack(d);
+    if (m_panic) {
+      synchronize();
+      matchIf(tok_right_brace);
+      d = m_act.onErrorDeclaration();
+    }
+    ds.push_back(d);
+    ++m_globals;
   }
-  return ds;
 }
 
 declaration *parser::parseProgram() {
   m_act.enterGlobalScope();
-  decl_list decls = parseDeclarationSeq();
+  scratch_list<declaration *> decls(m_decl_stack);
+  parseDeclarationSequence(decls);
   m_act.leaveScope();
-  return m_act.onProgram(decls);
+  m_program = m_act.onProgram(decls.get());
+  return m_program;
 }
@@ -5,8 +5,17 @@
 
 #include "lexer.hpp"
 #include "semantics.hpp"
-
-#include <deque>
+#include "spsc_ring.hpp"
+#include "stack.hpp"
+#include "token_buffer.hpp"
+#include "token_ring.hpp"
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 class type;
@@ -19,6 +28,45 @@ using expr_list = std::vector<expression *>;
 using stmt_list = std::vector<statement *>;
 using decl_list = std::vector<declaration *>;
 
+// A list being built on top of a stack of scratch space, which is popped
+// back when the list goes out of scope. Lists that nest share the stack,
+// so once it has grown, building a list does not allocate.
+template <typename T> class scratch_list {
+public:
+  explicit scratch_list(std::vector<T> &stack)
+      : m_stack(stack), m_base(stack.size()) {}
+  ~scratch_list() { m_stack.resize(m_base); }
+
+  scratch_list(const scratch_list &) = delete;
+  scratch_list &operator=(const scratch_list &) = delete;
+
+  void push_back(T x) { m_stack.push_back(x); }
+
+  // Valid until the next push onto the stack
+  array_ref<T> get() const {
+    return {m_stack.data() + m_base, m_stack.size() - m_base};
+  }
+
+private:
+  std::vector<T> &m_stack;
+  std::size_t m_base;
+};
+
+// How the parser gets its tokens: pulled from the lexer one at a time,
+// lexed on another thread as the parser goes, or all lexed before parsing
+// starts, possibly on several threads (see parallel_lex.hpp). Parallel
+// lexing uses one thread unless the symbol table is concurrent.
+//
+// In pipelined mode the lexer interns identifiers on its own thread while
+// the caller may still use the table, so the table must be concurrent; the
+// parser throws std::invalid_argument otherwise.
+enum class lex_mode {
+  pull,
+  pipelined,
+  prelex,
+  parallel,
+};
+
 class parser {
 private:
   token_name lookahead();
@@ -26,45 +74,123 @@ private:
 
   token match(token_name n);
   token matchIf(token_name n);
-  token matchIfEquality();
-  token matchIfRelational();
-  token matchIfShift();
-  token matchIfAdditive();
-  token matchIfMultiplicative();
+
+  // Error recovery: error() records a diagnostic and puts the parser in
+  // panic mode, in which it stops building nodes and reports nothing more
+  // until synchronize() skips to a point where parsing can resume.
+  void error(const std::string &msg);
+  void synchronize();
 
   token accept();
   token peek();
   void fetch();
 
-  lexer m_lex;
+  // Speculative parsing: rewind() backs up to a position returned by
+  // mark(), and each mark() is matched by a release(). When not pre-lexed,
+  // how far the parser can back up is bounded by the lookahead ring, which
+  // throws std::length_error rather than drop a kept token.
+  std::size_t mark();
+  void rewind(std::size_t pos);
+  void release();
+
+  bool isPrelexed() const {
+    return m_mode == lex_mode::prelex || m_mode == lex_mode::parallel;
+  }
+
+  void produce();
+  void stop();
+
+  expression *onBinaryExpression(unsigned prec, token op, expression *e1,
+                                 expression *e2);
 
-  std::deque<token> m_tok;
+  statement *dispatchStatement();
+  statement *parseFunctionBody(declaration *d);
+  bool skipBlock();
+
+  lexer m_lex;
+  lex_mode m_mode;
+
+  // Lookahead when not pre-lexed. The grammar needs at most three tokens
+  // (lookahead(2) in parseDeclaration); the rest bounds speculation.
+  static constexpr std::size_t lookahead_capacity = 16;
+  token_ring<lookahead_capacity> m_tok;
+
+  // In pipelined mode, the lexer thread and the tokens it has produced. An
+  // error is stored before tok_eof is pushed after it.
+  using pipe_ring = spsc_ring<token, 4096>;
+  std::unique_ptr<pipe_ring> m_ring;
+  std::thread m_producer;
+  std::atomic<bool> m_stop;
+  std::exception_ptr m_error;
+
+  // The whole input when pre-lexed, and the position of the next token
+  token_buffer m_buf;
+  std::size_t m_pos;
+
+  // Bounds the native stack used by nested expressions and statements
+  stack_guard m_stack;
+
+  // Prefix operators awaiting their operand in parseUnaryExpression
+  std::vector<token> m_prefix;
+
+  // Scratch space for the lists being built (see scratch_list)
+  std::vector<expression *> m_expr_stack;
+  std::vector<statement *> m_stmt_stack;
+  std::vector<declaration *> m_decl_stack;
+
+  // Errors found so far, and whether the parser is recovering from one
+  std::vector<diagnostic> m_diags;
+  bool m_panic;
+
+  // A body not yet parsed: the position of its '{', and how many of the
+  // program's declarations, up to and including its function, it can see
+  struct deferred_body {
+    std::size_t pos;
+    std::size_t visible;
+  };
+
+  // Whether function bodies are deferred, the bodies not yet parsed, the
+  // functions deferred, in source order, and the number of declarations
+  // parsed so far at the top level
+  bool m_defer;
+  std::unordered_map<declaration *, deferred_body> m_deferred;
+  std::vector<declaration *> m_deferred_order;
+  std::size_t m_globals;
+  declaration *m_program;
 
   semantics m_act;
 
 public:
-  parser(symbol_table &syms, const file &f);
+  parser(symbol_table &syms, ast_context &ast, const file &f,
+         lex_mode mode = lex_mode::pull);
+  ~parser();
+
+  const std::vector<diagnostic> &getDiagnostics() const { return m_diags; }
+
+  // Deferred function bodies, for tools that only need the declarations.
+  // When pre-lexed, parseProgram can skip each body by matching braces and
+  // leave its body null; parseDeferredBody parses it when it is needed and
+  // returns it, or null if it was not deferred. Otherwise bodies are always
+  // parsed in place.
+  void setDeferBodies(bool defer) { m_defer = defer; }
+  statement *parseDeferredBody(declaration *d);
+  void parseDeferredBodies();
+
+  parser(const parser &) = delete;
+  parser &operator=(const parser &) = delete;
 
-  void parseType();
-  void *parseBasicType();
+  type *parseType();
+  type *parseBasicType();
 
   expression *parseExpression();
   expression *parseAssignmentExpression();
   expression *parseConditionalExpression();
-  expression *parseLogicalOrExpression();
-  expression *parseLogicalAndExpression();
-  expression *parseBitwiseOrExpression();
-  expression *parseBitwiseAndExpression();
-  expression *parseEqualityExpression();
-  expression *parseRelationalExpression();
-  expression *parseShiftExpression();
-  expression *parseAdditiveExpression();
-  expression *parseMultiplicativeExpression();
+  expression *parseBinaryExpression(unsigned min);
   expression *parseCastExpression();
   expression *parseUnaryExpression();
   expression *parsePostfixExpression();
   expression *parsePrimaryExpression();
-  expr_list parseArgumentList();
+  void parseArgumentList(scratch_list<expression *> &args);
 
   statement *parseStatement();
   statement *parseBlockStatement();
@@ -75,7 +201,7 @@ public:
   statement *parseReturnStatement();
   statement *parseDeclarationStatement();
   statement *parseExpressionStatement();
-  stmt_list parseStatementSequence();
+  void parseStatementSequence(scratch_list<statement *> &ss);
 
   declaration *parseDeclaration();
   declaration *parseLocalDeclaration();
@@ -85,14 +211,10 @@ public:
   declaration *parseValueDefinition();
   declaration *parseFunctionDefinition();
   declaration *parseParameter();
-  decl_list parseParameterList();
-  decl_list parseParameterClause();
-  decl_list parseDeclarationSequence();
+  void parseParameterList(scratch_list<declaration *> &params);
+  void parseParameterClause(scratch_list<declaration *> &params);
+  void parseDeclarationSequence(scratch_list<declaration *> &ds);
 
   declaration *parseProgram();
 };
 
-inline parser::parser(symbol_table &syms, const file &f)
-    : m_lex(syms, f) m_tok() {
-  fetch();
-}
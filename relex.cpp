@@ -0,0 +1,42 @@
+#include "relex.hpp"
+#include "lexer.hpp"
+
+std::size_t relex(symbol_table& syms, const source& src, const char* first,
+                  const char* last, const text_edit& edit,
+                  token_buffer& toks) {
+  assert(edit.offset + edit.inserted <= std::size_t(last - first));
+  std::int64_t delta = std::int64_t(edit.inserted) - edit.removed;
+
+  const char* line = first + edit.offset;
+  while (line != first && line[-1] != '\n')
+    --line;
+  std::uint32_t start = line - first;
+  std::uint32_t edit_end = edit.offset + edit.inserted;
+
+  // Lex until a token starts after the edit where an old one did. The old
+  // tokens [begin, end) are the ones replaced.
+  std::size_t begin = toks.lowerBound(start);
+  std::size_t end = begin;
+  token_buffer fresh(syms, src.getId(), first);
+  lexer lex(syms, src, first, start, last - first);
+  while (true) {
+    token tok = lex.scan();
+    std::uint32_t offset = tok.getLocation().offset;
+    if (offset >= edit_end) {
+      std::int64_t old = offset - delta;
+      while (end != toks.size() && toks.getOffset(end) < old)
+        ++end;
+      if (end != toks.size() && toks.getOffset(end) == old)
+        break;
+    }
+    fresh.push_back(tok);
+    if (!tok) {
+      end = toks.size();
+      break;
+    }
+  }
+
+  toks.rebase(first, end, delta);
+  toks.replace(begin, end, fresh);
+  return fresh.size();
+}
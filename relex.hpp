@@ -0,0 +1,28 @@
+#pragma once
+
+//
+// Incremental lexing
+//
+// After an edit, only the tokens near it need lexing again. No token spans
+// a line break, so lexing restarts at the beginning of the edited line.
+// The lexer carries no state from one token to the next, so once it starts
+// a token after the edit at the same place as an old token (allowing for
+// the change in length), every token from there on is the same as before
+// and only needs its offset shifted.
+//
+
+#include "token_buffer.hpp"
+
+// Replacing removed bytes at offset with inserted new ones
+struct text_edit {
+  std::uint32_t offset;
+  std::uint32_t removed;
+  std::uint32_t inserted;
+};
+
+// Updates toks, lexed from the text before the edit, to match the text
+// [first, last) after it, which is followed by a NUL. The old text need not
+// still exist. Returns the number of tokens lexed.
+std::size_t relex(symbol_table& syms, const source& src, const char* first,
+                  const char* last, const text_edit& edit,
+                  token_buffer& toks);
@@ -1,3 +1,4 @@
+#include "casting.hpp"
 #include "symbol.hpp"
 
 #include <cassert>
@@ -6,10 +7,14 @@
 class declaration;
 
 struct scope : std::unordered_map<symbol, decl *> {
-  scope(scope *p = nullptr) : parent(p) {}
+  enum kind { global_kind, parameter_kind, block_kind };
+
+  scope(kind k, scope *p = nullptr) : m_kind(k), parent(p) {}
 
   virtual ~scope() = default;
 
+  kind getKind() const { return m_kind; }
+
   declaration *lookup(symbol sym) const {
     auto iter = find(sym);
     return iter == end() ? nullptr : iter->second;
@@ -20,17 +25,24 @@ struct scope : std::unordered_map<symbol, decl *> {
     emplace(sym, d);
   }
 
+  kind m_kind;
   scope *parent;
 };
 
 struct global_scope : scope {
-  using scope::scope;
+  global_scope() : scope(global_kind) {}
+
+  static bool classof(const scope *s) { return s->getKind() == global_kind; }
 };
 
 struct parameter_scope : scope {
-  using scope::scope;
+  parameter_scope(scope *p) : scope(parameter_kind, p) {}
+
+  static bool classof(const scope *s) { return s->getKind() == parameter_kind; }
 };
 
 struct block_scope : scope {
-  using scope::scope;
-}
+  block_scope(scope *p) : scope(block_kind, p) {}
+
+  static bool classof(const scope *s) { return s->getKind() == block_kind; }
+};
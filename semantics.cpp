@@ -8,10 +8,10 @@
 #include <iostream>
 #include <sstream>
 
-semantics::semantics()
-    : m_scope(nullptr), m_func(nullptr), m_bool(new bool_type()),
-      m_char(new char_type()), m_int(new int_type()),
-      m_float(new float_type()) {}
+semantics::semantics(ast_context &ast)
+    : m_ast(ast), m_scope(nullptr), m_func(nullptr),
+      m_bool(ast.getBoolType()), m_char(ast.getCharType()),
+      m_int(ast.getIntType()), m_float(ast.getFloatType()) {}
 
 semantics::~semantics() {
   assert(!m_scope);
@@ -39,7 +39,7 @@ expression *semantics::onAssignmentExpression(expression *e1, expression *e2) {
   type *t2 = e2->getType();
   requireSame(t1, t2);
 
-  return new assign_expr(e1->getType(), e1, e2);
+  return m_ast.make<assign_expr>(e1->getType(), e1, e2);
 }
 
 expression *semantics::onConditionalExpression(expression *e1, expression *e2,
@@ -50,37 +50,37 @@ expression *semantics::onConditionalExpression(expression *e1, expression *e2,
   e2 = convertToType(e2, c);
   e3 = convertToType(e3, c);
 
-  return new cond_expr(c, e1, e2, e3);
+  return m_ast.make<cond_expr>(c, e1, e2, e3);
 }
 
 expression *semantics::onLogicalOrExpression(expression *e1, expression *e2) {
   e1 = requireBoolean(e1);
   e2 = requireBoolean(e2);
-  return new bop_expr(m_bool, bo_lor, e1, e2);
+  return m_ast.make<bop_expr>(m_bool, bo_lor, e1, e2);
 }
 
 expression *semantics::onLogicalAndExpression(expression *e1, expression *e2) {
   e1 = requireBoolean(e1);
   e2 = requireBoolean(e2);
-  return new bop_expr(m_bool, bo_land, e1, e2);
+  return m_ast.make<bop_expr>(m_bool, bo_land, e1, e2);
 }
 
 expression *semantics::onBitwiseOrExpression(expresison *e1, expression *e2) {
   e1 = requireInteger(e1);
   e2 = requireInteger(e2);
-  return new bop_expr(m_int, bo_ior, e1, e2);
+  return m_ast.make<bop_expr>(m_int, bo_ior, e1, e2);
 }
 
 expression *semantics::onBitwiseXorExpression(expresison *e1, expression *e2) {
   e1 = requireInteger(e1);
   e2 = requireInteger(e2);
-  return new bop_expr(m_int, bo_xor, e1, e2);
+  return m_ast.make<bop_expr>(m_int, bo_xor, e1, e2);
 }
 
 expression *semantics::onBitwiseAndExpression(expresison *e1, expression *e2) {
   e1 = requireInteger(e1);
   e2 = requireInteger(e2);
-  return new bop_expr(m_int, bo_and, e1, e2);
+  return m_ast.make<bop_expr>(m_int, bo_and, e1, e2);
 }
 
 static bop getRelationalOperator(relational_op op) {
@@ -105,7 +105,7 @@ expression *semantics::onEqualityExpression(token tok, expression *e1,
   e1 = requireScalar(e1);
   e2 = requireScalar(e2);
   relational_op op = tok.getRelationalOperator();
-  return new bop_expr(m_bool, getRelationalOperator(op), e1, e2);
+  return m_ast.make<bop_expr>(m_bool, getRelationalOperator(op), e1, e2);
 }
 
 expression *semantics::onRelationalExpression(token tok, expression *e1,
@@ -113,7 +113,7 @@ expression *semantics::onRelationalExpression(token tok, expression *e1,
   e1 = requireNumeric(e1);
   e2 = requireNumeric(e2);
   relation_op op = tok.getRelationOperator();
-  return new bop_expr(m_bool, getRelationalOperator(op), e1, e2);
+  return m_ast.make<bop_expr>(m_bool, getRelationalOperator(op), e1, e2);
 }
 
 static bop getBitwiseOperator(bitwise_op op) {
@@ -138,7 +138,7 @@ expression *semantics::onShiftExpression(token tok, expression *e1,
   e1 = requireInteger(e1);
   e2 = requireInteger(e2);
   bitwise_op op = tok.getBitwiseOperator();
-  return new bop_expr(m_int, getBitwiseOperator(op), e1, e2);
+  return m_ast.make<bop_expr>(m_int, getBitwiseOperator(op), e1, e2);
 }
 
 static bop getArithmeticOperator(arithmetic_op op) {
@@ -163,7 +163,7 @@ expression *semantics::onAdditiveExpression(token tok, expression *e1,
   type *t = requireSame(e1->getType(), e2->getType());
 
   arithmetic_op op = tok.getArithmeticOperator();
-  return new bop_expr(t, getArithmeticOperator(op), e1, e2);
+  return m_ast.make<bop_expr>(t, getArithmeticOperator(op), e1, e2);
 }
 
 expression *semantics::onMultiplicativeExpression(token tok, expression *e1,
@@ -173,11 +173,11 @@ expression *semantics::onMultiplicativeExpression(token tok, expression *e1,
   type *t = requireSame(e1->getType(), e2->getType());
 
   arithmetic_op op = tok.getArithmeticOperator();
-  return new bop_expr(t, getArithmeticOperator(op), e1, e2);
+  return m_ast.make<bop_expr>(t, getArithmeticOperator(op), e1, e2);
 }
 
 expression *semantics::onCastExpression(expression *e, type *t) {
-  return new case_expr(convertToType(e, t), t);
+  return m_ast.make<cast_expr>(convertToType(e, t), t);
 }
 
 static uop getUnaryOp(token tok) {
@@ -225,14 +225,15 @@ expressino *semantics::onUnaryExpression(token tok, expression *e) {
   case uo_deref:
     throw std::logic_error("Not implemented");
   }
-  return new uop_expr(op, e);
+  return m_ast.make<uop_expr>(op, e);
 }
 
-expressino *semantics::onCallExpression(expression *e, const expr_list &args) {
+expressino *semantics::onCallExpression(expression *e,
+                                        array_ref<expression *> args) {
   e = requireFunction(e);
-  func_type *t = static_cast<func_type *>(e->getType());
+  func_type *t = cast<func_type>(e->getType());
 
-  type_list &params = t->getParameterTypes();
+  array_ref<type *> params = t->getParameterTypes();
   if (params.size() < args.size())
     throw std::runtime_error("Too many arguments");
   if (args.size() < params.size())
@@ -245,28 +246,32 @@ expressino *semantics::onCallExpression(expression *e, const expr_list &args) {
       throw std::runtime_error("Arguments mismatch");
   }
 
-  return new call_expr(t->getReturnType(), e, args);
+  return m_ast.makeTrailing<call_expr, expression *>(
+      args.size(), t->getReturnType(), e, args);
 }
 
-expression *semantics::onIndexExpression(expression *e, const expr_list &args) {
+expression *semantics::onIndexExpression(expression *e,
+                                         array_ref<expression *> args) {
   throw std::runtime_error("Not implemented");
 }
 
 expression *semantics::onIntegerLiteral(token tok) {
   int val = tok.getInteger();
-  return new int_expr(m_int, val);
+  return m_ast.make<int_expr>(m_int, val);
 }
 
 expression *semantics::onBooleanLiteral(token tok) {
   int val = tok.getInteger();
-  return new bool_expr(m_bool, val);
+  return m_ast.make<bool_expr>(m_bool, val);
 }
 
 expression *semantics::onFloatLiteral(token tok) {
   int val = tok.getInteger();
-  return new float_expr(m_float, val);
+  return m_ast.make<float_expr>(m_float, val);
 }
 
+expression *semantics::onErrorExpression() { return m_ast.make<error_expr>(); }
+
 expression *semantics::onIdExpression(token tok) {
   symbol sym = tok.getIdentifier();
 
@@ -277,24 +282,24 @@ expression *semantics::onIdExpression(token tok) {
   }
 
   type *t;
-  typed_decl *td = dynamic_cast<typed_decl *>(d);
+  typed_decl *td = cast<typed_decl>(d);
   if (td->isVariable())
-    t = new ref_type(td->getType());
+    t = m_ast.getRefType(td->getType());
   else
     t = td->getType();
 
-  return new id_expr(t, d);
+  return m_ast.make<id_expr>(t, d);
 }
 
-statement *semantics::onBlockStatement(const stmt_list &ss) {
-  return new block_stmt(ss);
+statement *semantics::onBlockStatement(array_ref<statement *> ss) {
+  return m_ast.makeTrailing<block_stmt, statement *>(ss.size(), ss);
 }
 
 void semantics::startBlock() {
   scope *parent = getCurrentScope()->parent;
-  if (dynamic_cast<global_scope *>(parent)) {
+  if (isa<global_scope>(parent)) {
     func_decl *func = getCurrentFunction();
-    for (declaration *param : func->m_params)
+    for (declaration *param : func->getParameters())
       declare(parm);
   }
 }
@@ -303,27 +308,29 @@ void semantics::finishBlock() {}
 
 statement *semantics::onIfStatement(expression *e, statement *s1,
                                     statement *s2) {
-  return new if_stmt(e, s1, s2);
+  return m_ast.make<if_stmt>(e, s1, s2);
 }
 
 statement *semantics::onWhileStatement(expression *e, statement *s) {
-  return new while_stmt(e, s);
+  return m_ast.make<while_stmt>(e, s);
 }
 
-statement *semantics::onBreakStatement() { return new break_stmt(); }
+statement *semantics::onBreakStatement() { return m_ast.make<break_stmt>(); }
+
+statement *semantics::onContinueStatement() { return m_ast.make<cont_stmt>(); }
 
-statement *semantics::onContinueStatement() { return cont_stmt(); }
+statement *semantics::onErrorStatement() { return m_ast.make<error_stmt>(); }
 
 statement *semantics::onReturnStatement(expression *e) {
-  return new ret_stmt(e);
+  return m_ast.make<ret_stmt>(e);
 }
 
 statement *semantics::onDeclarationStatement(declaration *d) {
-  return new decl_stmt(d);
+  return m_ast.make<decl_stmt>(d);
 }
 
 statement *semantics::onExpressionStatement(expression *e) {
-  return new expr_stmt(e);
+  return m_ast.make<expr_stmt>(e);
 }
 
 void semantics::declare(declaration *d) {
@@ -337,75 +344,79 @@ void semantics::declare(declaration *d) {
 }
 
 declaration *semantics::onVariableDeclaration(token n, type *t) {
-  declaration *var = new var_decl(n.getIdentifier(), t);
+  declaration *var = m_ast.make<var_decl>(n.getIdentifier(), t);
   declare(var);
   return var;
 }
 
 declaration *semantics::onVariableDefinition(declaration *d, expression *e) {
-  var_decl *var = static_cast<var_decl *>(d);
+  var_decl *var = cast<var_decl>(d);
   var->setInit(e);
   return var;
 }
 
 declaration *semantics::onConstantDeclaration(token n, type *t) {
-  declaration *var = new const_decl(n.getIdentifier(), t);
+  declaration *var = m_ast.make<const_decl>(n.getIdentifier(), t);
   decalre(var);
   return var;
 }
 
 declaration *semantics::onConstantDefinition(declaration *d, expression *e) {
-  const_decl *var = static_cast<const_decl *>(d);
+  const_decl *var = cast<const_decl>(d);
   return var;
 }
 
 declaration *semantics::onValueDeclaration(token n, type *t) {
-  declaration *val = new value_decl(n.getIdentifier(), t);
+  declaration *val = m_ast.make<val_decl>(n.getIdentifier(), t);
   declare(val);
   return val;
 }
 
 declaration *semantics::onValueDefiniton(declaration *d, expression *e) {
-  value_decl *val = static_cast<value_decl *>(d);
+  val_decl *val = cast<val_decl>(d);
   val->setInit(e);
   return val;
 }
 
 declaration *semantics::onParameterDeclaration(token n, type *t) {
-  declaration *param = new param_decl(n.getIdentifier(), t);
+  declaration *param = m_ast.make<param_decl>(n.getIdentifier(), t);
   declare(param);
   return param;
 }
 
-static type_list getParameterTypes(const decl_list &params) {
+static type_list getParameterTypes(array_ref<declaration *> params) {
   type_list types;
   for (const decl *d : params)
-    types.pushBack(static_cast<const param_decl *>(d)->getType());
+    types.pushBack(cast<param_decl>(d)->getType());
   return types;
 }
 
-declaration *semantics::onFunctionDeclaration(token n, const decl_list &params,
+declaration *semantics::onFunctionDeclaration(token n,
+                                              array_ref<declaration *> params,
                                               type *ret) {
-  func_type *ty = new func_type(getParameterTypes(params), ret);
-  func_decl *func = new func_decl(n.getIdentifier(), ty, params);
+  type_list types = getParameterTypes(params);
+  func_type *ty = cast<func_type>(m_ast.getFuncType(types, ret));
+  func_decl *func = m_ast.makeTrailing<func_decl, declaration *>(
+      params.size(), n.getIdentifier(), ty, params);
   func->setType(ty);
   declare(func);
 
-  assert(!m_func);
-  m_func = func;
-
   return func;
 }
 
 declaration *semantics::onFunctionDefiniton(declaration *d, statement *s) {
-  func_decl *func = static_cast<func_decl *>(d);
+  func_decl *func = cast<func_decl>(d);
   func->setBody(s);
 
   return func;
 }
 
-declaration semantics::onProgram(const decl_list &decls) {
-  return new prog_decl(decls);
+declaration *semantics::onErrorDeclaration() {
+  return m_ast.make<error_decl>();
+}
+
+declaration semantics::onProgram(array_ref<declaration *> decls) {
+  return m_ast.makeTrailing<prog_decl, declaration *>(decls.size(), decls);
 }
 
 void semantics::enterGlobalScope() {
@@ -413,6 +424,32 @@ void semantics::enterGlobalScope() {
   m_scope = new global_scope();
 }
 
+// A global scope holding the first n declarations of a parsed program, for
+// a function body parsed after the rest of it.
+void semantics::enterProgramScope(declaration *d, std::size_t n) {
+  enterGlobalScope();
+  array_ref<declaration *> ds = cast<prog_decl>(d)->getDeclarations();
+  assert(n <= ds.size());
+  for (std::size_t i = 0; i != n; ++i)
+    if (ds[i]->getKind() != declaration::error_kind)
+      m_scope->declare(ds[i]->getName(), ds[i]);
+}
+
+// The scope of a function body: its parameters, declared again since the
+// scope they were parsed in is gone by then.
+void semantics::enterFunctionScope(declaration *d) {
+  assert(!m_func);
+  m_func = cast<func_decl>(d);
+  enterParameterScope();
+  for (declaration *p : m_func->getParameters())
+    m_scope->declare(p->getName(), p);
+}
+
+void semantics::leaveFunctionScope() {
+  leaveScope();
+  m_func = nullptr;
+}
+
 void semantics::enterParameterScope() {
   m_scope = new parameter_scope(m_scope);
 }
@@ -425,6 +462,14 @@ void semantics::leaveScope() {
   delete current;
 }
 
+// Leaves every open scope and the current function, for a parse that was
+// abandoned by an exception.
+void semantics::leaveAllScopes() {
+  while (m_scope)
+    leaveScope();
+  m_func = nullptr;
+}
+
 declaration *semantics::lookup(symbol n) {
   scope *s = getCurrentScope();
   while (s) {
@@ -505,7 +550,7 @@ type *semantics::commonType(type *t1, type *t2) {
 expression *semantics::convertToValue(expression *e) {
   type *t = e->getType();
   if (t->isReference())
-    return new conv_expr(e, conv_value, t->getObjectType());
+    return m_ast.make<conv_expr>(e, conv_value, t->getObjectType());
   return e;
 }
 
@@ -520,7 +565,7 @@ expression *semantics::convertToBool(expression *e) {
   case type::float_kind:
   case type::ptr_kind:
   case type::func_kind:
-    return new conv_expr(e, conv_bool, m_bool);
+    return m_ast.make<conv_expr>(e, conv_bool, m_bool);
   default:
     throw std::runtime_error("Cannot convert to bool");
   }
@@ -533,7 +578,7 @@ expression *semantics::convertToChar(expression *e) {
   case type::char_kind:
     return e;
   case type::int_kind:
-    return new conv_expr(e, conv_char, m_char);
+    return m_ast.make<conv_expr>(e, conv_char, m_char);
   default:
     throw std::runtime_error("Cannot convert to char");
   }
@@ -546,10 +591,10 @@ expression *semantics::convertToInt(expression *e) {
   case type::int_kind:
     return e;
   case type::float_kind:
-    return new conv_expr(e, conv_trunc, m_int);
+    return m_ast.make<conv_expr>(e, conv_trunc, m_int);
   case type::bool_kind:
   case type::char_kind:
-    return new conv_expr(e, conv_int, m_int);
+    return m_ast.make<conv_expr>(e, conv_int, m_int);
   case type::ptr_kind:
   case type::func_kind:
   default:
@@ -562,7 +607,7 @@ expression *semantics::convertToFloat(expression *e) {
   type *t = e->getType();
   switch (t->getKind()) {
   case type::int_kind:
-    return new conv_expr(e, conv_ext, m_float);
+    return m_ast.make<conv_expr>(e, conv_ext, m_float);
   case type::float_kind:
     return e;
   default:
@@ -1,3 +1,4 @@
+#include "ast.hpp"
 #include "token.hpp"
 
 class type;
@@ -15,6 +16,8 @@ class scope;
 
 class semantics {
 private:
+  ast_context &m_ast;
+
   scope *m_scope;
 
   func_decl *m_func;
@@ -25,7 +28,7 @@ private:
   type *m_float;
 
 public:
-  semantics();
+  explicit semantics(ast_context &ast);
   ~semantics();
 
   type *onBasicType(token tok);
@@ -46,16 +49,17 @@ public:
                                          expression *e2);
   expression *onCastExpression(expression *e, type *t);
   expression *onUnaryExpression(token tok, expression *e);
-  expression *onCallExpression(expression *e, const expr_list &args);
-  expression *onIndexExpression(expression *e, const expr_list &args);
+  expression *onCallExpression(expression *e, array_ref<expression *> args);
+  expression *onIndexExpression(expression *e, array_ref<expression *> args);
   expression *onIdExpression(token tok);
   expression *onIntegerLiteral(token tok);
   expression *onBooleanLiteral(token tok);
   expression *onFloatLiteral(token tok);
+  expression *onErrorExpression();
 
   void startBlock();
   void finishBlock();
-  statement *onBlockStatement(const stmt_list &ss);
+  statement *onBlockStatement(array_ref<statement *> ss);
   statement *onIfStatement(expression *e, statement *s1, statement *s2);
   statement *onWhileStatement(expression *e, statement *s);
   statement *onReturnStatement(expression *e);
@@ -63,6 +67,7 @@ public:
   statement *onExpressionStatement(expression *e);
   statement *onBreakStatement();
   statement *onContinueStatement();
+  statement *onErrorStatement();
 
   declaration *onVariableDeclaration(token n, type *t);
   declaration *onVariableDefinition(declaration *d, expression *e);
@@ -71,15 +76,21 @@ public:
   declaration *onValueDeclaration(token n, type *t);
   declaration *onValueDefiniton(declaration *d, expression *e);
   declaration *onParameterDeclaration(token n, type *t);
-  declaration *onFunctionDeclaration(token n, const decl_list &ps, type *t);
+  declaration *onFunctionDeclaration(token n, array_ref<declaration *> ps,
+                                     type *t);
   declaration *onFunctionDefiniton(declaration *d, statement *s);
+  declaration *onErrorDeclaration();
 
-  declaration *onProgram(const decl_list &ds);
+  declaration *onProgram(array_ref<declaration *> ds);
 
   void enterGlobalScope();
+  void enterProgramScope(declaration *d, std::size_t n);
+  void enterFunctionScope(declaration *d);
+  void leaveFunctionScope();
   void enterParameterScope();
   void enterBlockScope();
   void leaveScope();
+  void leaveAllScopes();
   scope *getCurrentScope() const { return m_func; }
 
   func_decl *getCurrentFunction() const { return m_func; }
@@ -0,0 +1,166 @@
+#include "skip.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SKIP_X86 1
+#endif
+
+// -------------------------------------
+// Scalar
+// -------------------------------------
+static const char* skip_blanks_scalar(const char* first, const char* last) {
+  while (first != last && (*first == ' ' || *first == '\t' || *first == '\n'))
+    ++first;
+  return first;
+}
+
+static void mark_newlines_scalar(const char* first, const char* last,
+                                 std::uint32_t base,
+                                 std::vector<std::uint32_t>& starts) {
+  for (const char* p = first; p != last; ++p)
+    if (*p == '\n')
+      starts.push_back(base + (p - first) + 1);
+}
+
+
+#if SKIP_X86
+// -------------------------------------
+// Vector
+// -------------------------------------
+//
+// Each block is compared against the characters of interest, giving one
+// bit per byte from movemask. The first clear bit of the blank mask ends a
+// run of blanks; each set bit of the newline mask starts a line.
+
+static inline void add_lines(unsigned mask, std::uint32_t offset,
+                             std::vector<std::uint32_t>& starts) {
+  while (mask) {
+    starts.push_back(offset + __builtin_ctz(mask) + 1);
+    mask &= mask - 1;
+  }
+}
+
+__attribute__((target("sse2")))
+static const char* skip_blanks_sse2(const char* first, const char* last) {
+  const __m128i sp = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i nl = _mm_set1_epi8('\n');
+
+  while (last - first >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    __m128i b = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp),
+                                          _mm_cmpeq_epi8(v, tab)),
+                             _mm_cmpeq_epi8(v, nl));
+    unsigned blank = _mm_movemask_epi8(b);
+    if (blank != 0xffff)
+      return first + __builtin_ctz(~blank);
+    first += 16;
+  }
+  return skip_blanks_scalar(first, last);
+}
+
+__attribute__((target("avx2")))
+static const char* skip_blanks_avx2(const char* first, const char* last) {
+  const __m256i sp = _mm256_set1_epi8(' ');
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i nl = _mm256_set1_epi8('\n');
+
+  while (last - first >= 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    __m256i b = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, sp),
+                                                _mm256_cmpeq_epi8(v, tab)),
+                                _mm256_cmpeq_epi8(v, nl));
+    unsigned blank = _mm256_movemask_epi8(b);
+    if (blank != 0xffffffffu)
+      return first + __builtin_ctz(~blank);
+    first += 32;
+  }
+  return skip_blanks_sse2(first, last);
+}
+
+__attribute__((target("sse2")))
+static void mark_newlines_sse2(const char* first, const char* last,
+                               std::uint32_t base,
+                               std::vector<std::uint32_t>& starts) {
+  const __m128i nl = _mm_set1_epi8('\n');
+  const char* p = first;
+  for (; last - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    add_lines(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)), base + (p - first),
+              starts);
+  }
+  mark_newlines_scalar(p, last, base + (p - first), starts);
+}
+
+__attribute__((target("avx2")))
+static void mark_newlines_avx2(const char* first, const char* last,
+                               std::uint32_t base,
+                               std::vector<std::uint32_t>& starts) {
+  const __m256i nl = _mm256_set1_epi8('\n');
+  const char* p = first;
+  for (; last - p >= 32; p += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    add_lines(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl)),
+              base + (p - first), starts);
+  }
+  mark_newlines_sse2(p, last, base + (p - first), starts);
+}
+#endif
+
+
+// -------------------------------------
+// Dispatch
+// -------------------------------------
+using skip_fn = const char* (*)(const char*, const char*);
+using mark_fn = void (*)(const char*, const char*, std::uint32_t,
+                         std::vector<std::uint32_t>&);
+
+static int select_isa() {
+#if SKIP_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return 2;
+  if (__builtin_cpu_supports("sse2"))
+    return 1;
+#endif
+  return 0;
+}
+
+static skip_fn select_skip_blanks() {
+  switch (select_isa()) {
+#if SKIP_X86
+    case 2: return skip_blanks_avx2;
+    case 1: return skip_blanks_sse2;
+#endif
+    default: return skip_blanks_scalar;
+  }
+}
+
+static mark_fn select_mark_newlines() {
+  switch (select_isa()) {
+#if SKIP_X86
+    case 2: return mark_newlines_avx2;
+    case 1: return mark_newlines_sse2;
+#endif
+    default: return mark_newlines_scalar;
+  }
+}
+
+const char* skip_blanks(const char* first, const char* last) {
+  static const skip_fn impl = select_skip_blanks();
+  return impl(first, last);
+}
+
+void mark_newlines(const char* first, const char* last, std::uint32_t base,
+                   std::vector<std::uint32_t>& starts) {
+  static const mark_fn impl = select_mark_newlines();
+  impl(first, last, base, starts);
+}
+
+// The C library's memchr is already vectorized and dispatched at run time.
+const char* find_newline(const char* first, const char* last) {
+  const void* p = std::memchr(first, '\n', last - first);
+  return p ? static_cast<const char*>(p) : last;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+//
+// Vectorized helpers for skipping blanks and finding newlines
+//
+// The implementations are chosen on first use: AVX2 or SSE2 where the CPU
+// supports them, and a scalar loop otherwise.
+//
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Returns the first character in [first, last) that is not a space, tab or
+// newline, or last if there is none.
+const char* skip_blanks(const char* first, const char* last);
+
+// Returns the first newline in [first, last), or last if there is none.
+const char* find_newline(const char* first, const char* last);
+
+// Appends base + i + 1 to starts for each newline at first[i] in
+// [first, last); that is, the offset of the line it begins.
+void mark_newlines(const char* first, const char* last, std::uint32_t base,
+                   std::vector<std::uint32_t>& starts);
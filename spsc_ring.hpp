@@ -0,0 +1,69 @@
+#pragma once
+
+//
+// A bounded single-producer, single-consumer queue
+//
+// One thread pushes and one thread pops, with no locks. Each side owns one
+// index and only reads the other's, and keeps a cached copy of it so that
+// the shared cache line is touched only when the ring looks full (or
+// empty).
+//
+
+#include <atomic>
+#include <cstddef>
+
+template<typename T, std::size_t N>
+class spsc_ring {
+  static_assert(N && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+public:
+  spsc_ring() : m_head(0), m_tail_cache(0), m_tail(0), m_head_cache(0) { }
+
+  spsc_ring(const spsc_ring&) = delete;
+  spsc_ring& operator=(const spsc_ring&) = delete;
+
+  // Called by the producer. Returns false if the ring is full.
+  bool try_push(const T& x);
+
+  // Called by the consumer. Returns false if the ring is empty.
+  bool try_pop(T& x);
+
+private:
+  static constexpr std::size_t cache_line = 64;
+
+  // The next slot to pop, and the consumer's copy of m_tail
+  alignas(cache_line) std::atomic<std::size_t> m_head;
+  std::size_t m_tail_cache;
+
+  // The next slot to push, and the producer's copy of m_head
+  alignas(cache_line) std::atomic<std::size_t> m_tail;
+  std::size_t m_head_cache;
+
+  alignas(cache_line) T m_slots[N];
+};
+
+template<typename T, std::size_t N>
+inline bool spsc_ring<T, N>::try_push(const T& x) {
+  std::size_t tail = m_tail.load(std::memory_order_relaxed);
+  if (tail - m_head_cache == N) {
+    m_head_cache = m_head.load(std::memory_order_acquire);
+    if (tail - m_head_cache == N)
+      return false;
+  }
+  m_slots[tail & (N - 1)] = x;
+  m_tail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+template<typename T, std::size_t N>
+inline bool spsc_ring<T, N>::try_pop(T& x) {
+  std::size_t head = m_head.load(std::memory_order_relaxed);
+  if (head == m_tail_cache) {
+    m_tail_cache = m_tail.load(std::memory_order_acquire);
+    if (head == m_tail_cache)
+      return false;
+  }
+  x = m_slots[head & (N - 1)];
+  m_head.store(head + 1, std::memory_order_release);
+  return true;
+}
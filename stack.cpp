@@ -0,0 +1,61 @@
+#include "stack.hpp"
+
+#include <exception>
+#include <new>
+
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+namespace {
+struct switch_frame {
+  void (*fn)(void*);
+  void* arg;
+  std::exception_ptr error;
+  ucontext_t caller;
+  ucontext_t callee;
+};
+
+// The frame being started; makecontext cannot portably pass a pointer.
+thread_local switch_frame* starting;
+}
+
+// The first function on a new segment. Exceptions cannot unwind past it,
+// so they are caught and carried back to the caller's stack. Returning
+// resumes the caller through uc_link.
+static void trampoline() {
+  switch_frame* frame = starting;
+  try {
+    frame->fn(frame->arg);
+  }
+  catch (...) {
+    frame->error = std::current_exception();
+  }
+}
+
+void call_on_new_stack(void (*fn)(void*), void* arg, std::size_t size) {
+  std::size_t page = ::sysconf(_SC_PAGESIZE);
+  size = (size + page - 1) / page * page;
+
+  // Pages are only committed as the stack grows into them. The lowest page
+  // is a guard, so an overflow still faults rather than corrupting memory.
+  void* mem = ::mmap(nullptr, size + page, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (mem == MAP_FAILED)
+    throw std::bad_alloc();
+  ::mprotect(mem, page, PROT_NONE);
+
+  switch_frame frame{fn, arg, nullptr, {}, {}};
+  ::getcontext(&frame.callee);
+  frame.callee.uc_stack.ss_sp = static_cast<char*>(mem) + page;
+  frame.callee.uc_stack.ss_size = size;
+  frame.callee.uc_link = &frame.caller;
+  ::makecontext(&frame.callee, trampoline, 0);
+
+  starting = &frame;
+  ::swapcontext(&frame.caller, &frame.callee);
+  ::munmap(mem, size + page);
+
+  if (frame.error)
+    std::rethrow_exception(frame.error);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+//
+// Deep recursion on heap-allocated stack segments
+//
+// The parser follows the nesting of its input, so a machine-generated file
+// with thousands of levels would overflow the native stack. Rather than
+// rewrite the parser around an explicit stack, each nesting point calls
+// through a stack_guard. Every so many levels the guard moves the rest of
+// the recursion onto a new segment, so the depth is limited only by
+// memory, while shallow code pays only for a counter.
+//
+
+#include <cstddef>
+#include <utility>
+
+// Runs fn(arg) on a new stack of at least the given size and returns when
+// it does. An exception thrown by fn is rethrown here.
+void call_on_new_stack(void (*fn)(void*), void* arg, std::size_t size);
+
+class stack_guard {
+public:
+  static constexpr unsigned default_levels = 256;
+  static constexpr std::size_t default_segment_size = 8 << 20;
+
+  explicit stack_guard(unsigned levels = default_levels,
+                       std::size_t segment_size = default_segment_size)
+      : m_depth(0), m_levels(levels), m_segment_size(segment_size) { }
+
+  // Calls f() one level deeper. The result must be default-constructible.
+  template<typename F>
+  auto operator()(F f) -> decltype(f());
+
+private:
+  struct scope {
+    explicit scope(unsigned& depth) : depth(depth) { ++depth; }
+    ~scope() { --depth; }
+    unsigned& depth;
+  };
+
+  unsigned m_depth;
+  unsigned m_levels;
+  std::size_t m_segment_size;
+};
+
+template<typename F>
+auto stack_guard::operator()(F f) -> decltype(f()) {
+  using result_type = decltype(f());
+  scope s(m_depth);
+  if (m_depth % m_levels != 0)
+    return f();
+
+  result_type result{};
+  std::pair<F*, result_type*> call(&f, &result);
+  call_on_new_stack([](void* p) {
+    auto* c = static_cast<std::pair<F*, result_type*>*>(p);
+    *c->second = (*c->first)();
+  }, &call, m_segment_size);
+  return result;
+}
@@ -1,3 +1,8 @@
+#pragma once
+
+#include "ast.hpp"
+#include "casting.hpp"
+
 #include <vector>
 
 class expression;
@@ -17,7 +22,8 @@ public:
     cont_kind,
     ret_kind,
     decl_kind,
-    expr_kind
+    expr_kind,
+    error_kind
   };
 
   virtual ~statement() = default;
@@ -29,13 +35,20 @@ protected:
 
 using statement_list = std::vector<statement *>;
 
-struct block_stmt : statement {
-  block_stmt(const stmt_list &ss) : statement(block_kind), m_stmts(ss) {}
+// The statements follow the node (see trailing_objects).
+struct block_stmt : statement, trailing_objects<block_stmt, statement *> {
+  block_stmt(array_ref<statement *> ss)
+      : statement(block_kind), m_num_stmts(ss.size()) {
+    initTrailingObjects(ss);
+  }
 
-  const stmt_list &getStatements() const { return m_stmts; }
-  stmt_list &getStatements() { return m_stmts; }
+  array_ref<statement *> getStatements() const {
+    return {getTrailingObjects(), m_num_stmts};
+  }
 
-  stmt_list m_stmts;
+  std::uint32_t m_num_stmts;
+
+  static bool classof(const statement *s) { return s->getKind() == block_kind; }
 };
 
 struct when_stmt : statement {
@@ -47,6 +60,8 @@ struct when_stmt : statement {
 
   expression *m_cond;
   statement *m_body;
+
+  static bool classof(const statement *s) { return s->getKind() == when_kind; }
 };
 
 struct if_stmt : statement {
@@ -60,6 +75,8 @@ struct if_stmt : statement {
   expression *m_cond;
   statement *m_true;
   statement *m_false;
+
+  static bool classof(const statement *s) { return s->getKind() == if_kind; }
 };
 
 struct while_stmt : statement {
@@ -71,30 +88,49 @@ struct while_stmt : statement {
 
   expression *m_cond;
   statememt *m_body;
+
+  static bool classof(const statement *s) { return s->getKind() == while_kind; }
 };
 
 struct break_stmt : statement {
   break_stmt() : statement(break_kind) {}
+
+  static bool classof(const statement *s) { return s->getKind() == break_kind; }
 };
 
 struct cont_stmt : statement {
-  cont_stmt() : statement(break_kind) {}
+  cont_stmt() : statement(cont_kind) {}
+
+  static bool classof(const statement *s) { return s->getKind() == cont_kind; }
 };
 
 struct ret_stmt : statement {
   ret_stmt(expression *e) : statement(ret_kind), m_val(e) {}
   expression *getValue() const { return m_val; }
   expression *m_val;
+
+  static bool classof(const statement *s) { return s->getKind() == ret_kind; }
 };
 
 struct decl_stmt : statement {
   decl_stmt(declaration *d) : statement(decl_kind), m_decl(d) {}
   declaration *getDeclaration() const { return m_decl; }
   declaration *m_decl;
+
+  static bool classof(const statement *s) { return s->getKind() == decl_kind; }
 };
 
 struct expr_stmt : statement {
   expr_stmt(expression *e) : statement(expr_kind), m_expr(e) {}
   expression *getExpression() const { return m_expr; }
   expression *m_expr;
+
+  static bool classof(const statement *s) { return s->getKind() == expr_kind; }
+};
+
+// Stands in for a statement with a syntax error
+struct error_stmt : statement {
+  error_stmt() : statement(error_kind) {}
+
+  static bool classof(const statement *s) { return s->getKind() == error_kind; }
 };
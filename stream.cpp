@@ -0,0 +1,49 @@
+#include "stream.hpp"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <unistd.h>
+
+input_stream::input_stream(const std::string& name, int fd,
+                           std::size_t capacity)
+    : m_name(name), m_fd(fd), m_capacity(capacity),
+      m_buf(new char[capacity + 1]), m_last(m_buf.get()), m_done(false),
+      m_offset(0) {
+  m_buf[0] = 0;
+}
+
+line_column input_stream::resolve(std::uint32_t offset) const {
+  return m_lines.resolve(offset);
+}
+
+bool input_stream::refill(const char* keep) {
+  assert(begin() <= keep && keep <= m_last);
+  if (m_done)
+    return false;
+
+  std::size_t kept = m_last - keep;
+  if (kept == m_capacity)
+    throw std::runtime_error("token exceeds the input window");
+
+  char* first = m_buf.get();
+  m_offset += keep - first;
+  std::memmove(first, keep, kept);
+
+  ssize_t n;
+  do
+    n = ::read(m_fd, first + kept, m_capacity - kept);
+  while (n < 0 && errno == EINTR);
+  if (n < 0)
+    throw std::runtime_error(std::strerror(errno));
+
+  if (n == 0)
+    m_done = true;
+
+  m_lines.add(first + kept, first + kept + n, m_offset + kept);
+  m_last = first + kept + n;
+  first[kept + n] = 0;
+  return n != 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "location.hpp"
+
+#include <cstddef>
+#include <memory>
+
+// A bounded window over an input read incrementally from a file
+// descriptor. The lexer scans the window in place and asks for a refill
+// when it runs into the end, so memory use depends only on the capacity
+// and not on the size of the input.
+//
+// Like file, the data in the window is always followed by a NUL sentinel.
+//
+// Text that has left the window cannot be revisited to find line numbers,
+// so the line starts of each chunk are recorded as it is read.
+class input_stream : public source {
+public:
+  static constexpr std::size_t default_capacity = 64 * 1024;
+
+  input_stream(const std::string& name, int fd,
+               std::size_t capacity = default_capacity);
+
+  const std::string& getName() const override { return m_name; }
+  line_column resolve(std::uint32_t offset) const override;
+
+  const char* begin() const { return m_buf.get(); }
+  const char* end() const { return m_last; }
+
+  // The offset of begin() within the whole input.
+  std::uint32_t getOffset() const { return m_offset; }
+
+  // True when the descriptor has been read to the end.
+  bool done() const { return m_done; }
+
+  // Moves the unconsumed bytes [keep, end()) to the front of the window and
+  // reads more input after them. Pointers into the old contents must be
+  // rebased by begin() - keep. Returns false if nothing more could be read.
+  bool refill(const char* keep);
+
+private:
+  std::string m_name;
+  int m_fd;
+  std::size_t m_capacity;
+  std::unique_ptr<char[]> m_buf;
+  const char* m_last;
+  bool m_done;
+  std::uint32_t m_offset;
+  line_map m_lines;
+};
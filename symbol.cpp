@@ -0,0 +1,148 @@
+#include "symbol.hpp"
+
+#include <cstring>
+
+// FNV-1a
+static std::uint32_t hash_string(std::string_view str) {
+  std::uint32_t h = 2166136261u;
+  for (char c : str) {
+    h ^= (unsigned char)c;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// Shards are chosen by the high bits of the hash and slots by the low bits.
+static constexpr unsigned concurrent_shard_bits = 6;
+static constexpr std::size_t initial_slots = 1024;
+
+symbol_table::symbol_table(mode m)
+    : m_concurrent(m == concurrent),
+      m_shard_shift(32 - (m_concurrent ? concurrent_shard_bits : 0)),
+      m_shards(new shard[std::size_t(1) << (32 - m_shard_shift)]),
+      m_next_id(0),
+      m_size(0) {
+  std::size_t shards = std::size_t(1) << (32 - m_shard_shift);
+  std::size_t slots = m_concurrent ? initial_slots / 16 : initial_slots;
+  for (std::size_t i = 0; i != shards; ++i) {
+    shard& sh = m_shards[i];
+    sh.arrays.emplace_back(new slot_array(slots));
+    sh.table.store(sh.arrays.back().get(), std::memory_order_relaxed);
+  }
+  for (auto& page : m_pages)
+    page.store(nullptr, std::memory_order_relaxed);
+}
+
+symbol_table::~symbol_table() {
+  for (auto& page : m_pages)
+    delete[] page.load(std::memory_order_relaxed);
+}
+
+// Probes t for str. On a miss, i is left at the empty slot that ends the
+// probe sequence.
+const symbol_entry* symbol_table::find(const slot_array* t, std::uint32_t h,
+                                       std::string_view str, std::size_t& i) {
+  i = h & t->mask;
+  while (const symbol_entry* ent =
+             t->slots[i].load(std::memory_order_acquire)) {
+    if (ent->hash == h && ent->len == str.size() &&
+        std::memcmp(ent->getText(), str.data(), str.size()) == 0)
+      return ent;
+    i = (i + 1) & t->mask;
+  }
+  return nullptr;
+}
+
+symbol symbol_table::get(std::string_view str) {
+  std::uint32_t h = hash_string(str);
+  shard& sh = m_shards[std::uint64_t(h) >> m_shard_shift];
+
+  std::size_t i;
+  if (const symbol_entry* ent =
+          find(sh.table.load(std::memory_order_acquire), h, str, i))
+    return symbol(ent);
+
+  if (!m_concurrent)
+    return insert(sh, h, str);
+  std::lock_guard<std::mutex> guard(sh.lock);
+  return insert(sh, h, str);
+}
+
+// Inserts str into sh, which the caller has locked if need be. Another
+// thread may have inserted it since the unlocked lookup, so look again.
+symbol symbol_table::insert(shard& sh, std::uint32_t h, std::string_view str) {
+  slot_array* t = sh.table.load(std::memory_order_relaxed);
+  std::size_t i;
+  if (const symbol_entry* ent = find(t, h, str, i))
+    return symbol(ent);
+
+  void* mem = sh.text.allocate(sizeof(symbol_entry) + str.size() + 1,
+                               alignof(symbol_entry));
+  symbol_entry* ent = static_cast<symbol_entry*>(mem);
+  ent->id = m_next_id.fetch_add(1, std::memory_order_relaxed);
+  ent->len = str.size();
+  ent->hash = h;
+  char* text = reinterpret_cast<char*>(ent + 1);
+  std::memcpy(text, str.data(), str.size());
+  text[str.size()] = 0;
+
+  publish(ent);
+  t->slots[i].store(ent, std::memory_order_release);
+  m_size.fetch_add(1, std::memory_order_release);
+
+  // Keep the load factor at or below one half.
+  if (++sh.count * 2 > t->mask + 1)
+    grow(sh);
+  return symbol(ent);
+}
+
+void symbol_table::grow(shard& sh) {
+  slot_array* old = sh.table.load(std::memory_order_relaxed);
+  slot_array* t = new slot_array((old->mask + 1) * 2);
+  sh.arrays.emplace_back(t);
+  for (std::size_t i = 0; i <= old->mask; ++i) {
+    const symbol_entry* ent = old->slots[i].load(std::memory_order_relaxed);
+    if (!ent)
+      continue;
+    std::size_t j = ent->hash & t->mask;
+    while (t->slots[j].load(std::memory_order_relaxed))
+      j = (j + 1) & t->mask;
+    t->slots[j].store(ent, std::memory_order_relaxed);
+  }
+  sh.table.store(t, std::memory_order_release);
+}
+
+// Page p of the directory holds ids [2^(p+b) - 2^b, 2^(p+b+1) - 2^b) where
+// b is first_page_bits.
+static unsigned page_of(std::uint32_t id, std::size_t& offset) {
+  std::uint64_t x = std::uint64_t(id) + (1u << 10);
+  unsigned msb = 63 - __builtin_clzll(x);
+  offset = x - (std::uint64_t(1) << msb);
+  return msb - 10;
+}
+
+void symbol_table::publish(const symbol_entry* ent) {
+  static_assert(first_page_bits == 10, "page_of assumes 1024-entry pages");
+  std::size_t offset;
+  unsigned p = page_of(ent->id, offset);
+
+  const symbol_entry** page = m_pages[p].load(std::memory_order_acquire);
+  if (!page) {
+    std::size_t n = std::size_t(1) << (p + first_page_bits);
+    const symbol_entry** fresh = new const symbol_entry*[n]();
+    if (m_pages[p].compare_exchange_strong(page, fresh,
+                                           std::memory_order_acq_rel))
+      page = fresh;
+    else
+      delete[] fresh;
+  }
+  page[offset] = ent;
+}
+
+// A symbol's id is only known to holders of the symbol, and the entry was
+// published before get() returned it.
+symbol symbol_table::operator[](std::uint32_t id) const {
+  std::size_t offset;
+  unsigned p = page_of(id, offset);
+  return symbol(m_pages[p].load(std::memory_order_acquire)[offset]);
+}
@@ -1,22 +1,128 @@
-#include <string>
-#include <unordered_set>
+#pragma once
 
-using symbol = const std::string*;
+#include "arena.hpp"
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
 
-class symbol_table {
-  std::unordered_set<std::string> m_syms;
+// The stored form of an interned spelling. The NUL-terminated text
+// immediately follows the entry in the symbol table's arena.
+struct symbol_entry {
+  std::uint32_t id;
+  std::uint32_t len;
+  std::uint32_t hash;
+
+  const char* getText() const {
+    return reinterpret_cast<const char*>(this + 1);
+  }
+};
 
+// A handle to an interned spelling. Two symbols are equal exactly when
+// they name the same spelling in the same table, and each carries a dense
+// 32-bit id that can index side tables.
+class symbol {
 public:
-  symbol get(const char* str);
-  symbol get(const std::string& str);
+  symbol() : m_ent(nullptr) {}
+  symbol(std::nullptr_t) : m_ent(nullptr) {}
+
+  std::uint32_t getId() const { return m_ent->id; }
+  std::string_view str() const { return {m_ent->getText(), m_ent->len}; }
+  const char* c_str() const { return m_ent->getText(); }
+
+  std::string_view operator*() const { return str(); }
+
+  explicit operator bool() const { return m_ent != nullptr; }
+
+  friend bool operator==(symbol a, symbol b) { return a.m_ent == b.m_ent; }
+  friend bool operator!=(symbol a, symbol b) { return a.m_ent != b.m_ent; }
 
+private:
+  friend class symbol_table;
+  explicit symbol(const symbol_entry* ent) : m_ent(ent) {}
+
+  const symbol_entry* m_ent;
 };
 
-inline symbol symbol_table::get(const char* str) {
-  return &*m_syms.insert(str).first;
+namespace std {
+template<>
+struct hash<symbol> {
+  std::size_t operator()(symbol sym) const { return sym.getId(); }
+};
 }
 
-inline symbol symbol_table::get(const std::string& str) {
-  return &*m_syms.insert(str).first;
-}
+// An open-addressing interner. Spellings are stored contiguously in arenas
+// and handed out with dense 32-bit ids.
+//
+// A concurrent table can be shared by several lexers running on different
+// threads. It is split into shards by hash; lookups of existing symbols
+// take no locks, and inserts lock only their shard. Symbols from any
+// thread compare equal by identity. Ids are dense but, across threads,
+// are assigned in no particular order.
+class symbol_table {
+public:
+  enum mode {
+    single_threaded,
+    concurrent
+  };
+
+  explicit symbol_table(mode m = single_threaded);
+  ~symbol_table();
+
+  symbol_table(const symbol_table&) = delete;
+  symbol_table& operator=(const symbol_table&) = delete;
+
+  bool isConcurrent() const { return m_concurrent; }
+
+  symbol get(std::string_view str);
+
+  // Returns the symbol with the given id.
+  symbol operator[](std::uint32_t id) const;
+
+  // The number of symbols inserted so far. Ids are handed out before their
+  // entries are published, so a symbol being inserted on another thread is
+  // not yet counted, and ids up to size() need not all be valid yet.
+  std::size_t size() const { return m_size.load(std::memory_order_acquire); }
+
+private:
+  using slot = std::atomic<const symbol_entry*>;
+
+  // A power-of-two array of slots. Readers may still be probing an array
+  // after it has been replaced, so old arrays live as long as the table.
+  struct slot_array {
+    explicit slot_array(std::size_t n) : mask(n - 1), slots(new slot[n]()) {}
+    std::size_t mask;
+    std::unique_ptr<slot[]> slots;
+  };
+
+  struct shard {
+    std::mutex lock;
+    arena text;
+    std::atomic<slot_array*> table;
+    std::size_t count = 0;
+    std::vector<std::unique_ptr<slot_array>> arrays;
+  };
+
+  static const symbol_entry* find(const slot_array* t, std::uint32_t h,
+                                  std::string_view str, std::size_t& i);
+  symbol insert(shard& sh, std::uint32_t h, std::string_view str);
+  void grow(shard& sh);
+
+  // The id directory is a sequence of pages of doubling size, so it can
+  // grow while other threads read it.
+  static constexpr unsigned first_page_bits = 10;
+  static constexpr unsigned max_pages = 32 - first_page_bits + 1;
+
+  void publish(const symbol_entry* ent);
+
+  bool m_concurrent;
+  unsigned m_shard_shift;
+  std::unique_ptr<shard[]> m_shards;
+  std::atomic<std::uint32_t> m_next_id;
+  std::atomic<std::uint32_t> m_size;
+  std::atomic<const symbol_entry**> m_pages[max_pages];
+};
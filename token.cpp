@@ -1,6 +1,7 @@
 #include "token.hpp"
 
 #include <cassert>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
 
@@ -44,6 +45,7 @@ to_string(token_name n) {
     case tok_character:           return "character";
     case tok_string:              return "string";
     case tok_type_specifier:      return "type-specifier";
+    case tok_error:               return "error";
     case tok_eof:                 return "eof";
   }
 }
@@ -103,11 +105,31 @@ const char* to_string(type_spec ts) {
 };
 
 
-token::token() : m_name(tok_eof) { }
+// Lexical errors
+const char* toString(lex_error e) {
+  switch (e) {
+    case err_invalid_character:           return "invalid character";
+    case err_unterminated_escape:         return "unterminated escape-sequence";
+    case err_invalid_escape:              return "invalid escape-sequence";
+    case err_unterminated_character:      return "unterminated character literal";
+    case err_empty_character:             return "invalid character literal";
+    case err_multiline_character:         return "invalid multi-line character";
+    case err_multibyte_character:         return "invalid multi-byte character";
+    case err_unterminated_string:         return "unterminated string literal";
+    case err_multiline_string:            return "invalid multi-line string";
+    case err_integer_out_of_range:        return "integer literal out of range";
+    case err_floating_point_out_of_range: return "floating-point literal out of range";
+  }
+  return "unknown error";
+}
+
 
-token::token(token_name n, token_attr a, location loc) :  m_name(n),
-                                                          m_attr(a),
-                                                          m_loc(loc) { }
+token::token() : m_offset(0), m_source(0), m_name(tok_eof) { }
+
+token::token(token_name n, token_attr a, location loc) : m_attr(a),
+                                                         m_offset(loc.offset),
+                                                         m_source(loc.source),
+                                                         m_name(n) { }
 
 static bool has_attribute(token_name n) {
 
@@ -126,6 +148,7 @@ static bool has_attribute(token_name n) {
     case tok_character:
     case tok_string:
     case tok_type_specifier:
+    case tok_error:
       return true;
 
     default:
@@ -133,19 +156,21 @@ static bool has_attribute(token_name n) {
   }
 }
 
-token::token(token_name n, location loc) : m_name(n), m_loc(loc) {
+token::token(token_name n, location loc) : m_offset(loc.offset),
+                                           m_source(loc.source),
+                                           m_name(n) {
   assert(!has_attribute(n));
 }
 
-token::token(symbol sym, location loc) : m_name(tok_identifier), m_attr(sym), m_loc(loc) { }
+token::token(symbol sym, location loc) : token(tok_identifier, token_attr(sym), loc) { }
 
-token::token(relational_op op, location loc) : m_name(tok_relational_op), m_attr(op), m_loc(loc) { }
+token::token(relational_op op, location loc) : token(tok_relational_op, token_attr(op), loc) { }
 
-token::token(arithmetic_op op, location loc) : m_name(tok_arithmetic_op), m_attr(op), m_loc(loc) { }
+token::token(arithmetic_op op, location loc) : token(tok_arithmetic_op, token_attr(op), loc) { }
 
-token::token(bitwise_op op, location loc) : m_name(tok_bitwise_op), m_attr(op), m_loc(loc) { }
+token::token(bitwise_op op, location loc) : token(tok_bitwise_op, token_attr(op), loc) { }
 
-token::token(logical_op op, location loc) : m_name(tok_logical_op), m_attr(op), m_loc(loc) { }
+token::token(logical_op op, location loc) : token(tok_logical_op, token_attr(op), loc) { }
 
 token::token(long long val, location loc) : token(tok_decimal_integer, decimal, val, loc) { }
 
@@ -178,22 +203,44 @@ static bool check_radix(token_name n, radix rad) {
 }
 
 
-token::token(token_name n, radix rad, long long val, location loc) : m_name(n),
-                                                                      m_attr(integer_attr{rad, val}),
-                                                                      m_loc(loc) {
+token::token(token_name n, radix rad, long long val, location loc)
+    : token(n, token_attr(val), loc) {
   assert(check_radix(n, rad));
 }
 
-token::token(double val, location loc) : m_name(tok_floating_point), m_attr(val), m_loc(loc) { }
+token::token(double val, location loc) : token(tok_floating_point, token_attr(val), loc) { }
+
+token::token(bool tf, location loc) : token(tok_boolean, token_attr(tf), loc) { }
+
+token::token(char c, location loc) : token(tok_character, token_attr(c), loc) { }
 
-token::token(bool tf, location loc) : m_name(tok_boolean), m_attr(tf), m_loc(loc) { }
+token::token(string_attr s, location loc) : token(tok_string, token_attr(s), loc) { }
 
-token::token(char c, location loc) : m_name(tok_character), m_attr(c), m_loc(loc) { }
+token::token(type_spec ts, location loc) : token(tok_type_specifier, token_attr(ts), loc) { }
 
-token::token(string_attr s, location loc) : m_name(tok_string), m_attr(s), m_loc(loc) { }
+token::token(lex_error e, location loc) : token(tok_error, token_attr(e), loc) { }
 
-token::token(type_spec ts, location loc) : m_name(tok_type_specifier), m_attr(ts), m_loc(loc) { }
 
+std::string_view string_attr::str() const {
+  if (isRaw()) {
+    const char* last = text + 1;
+    while (*last != '"')
+      ++last;
+    return {text + 1, std::size_t(last - text - 1)};
+  }
+  std::uint32_t len;
+  std::memcpy(&len, text - sizeof len, sizeof len);
+  return {text + 1, len};
+}
+
+string_attr string_attr::copy(arena& a, std::string_view s) {
+  std::uint32_t len = s.size();
+  char* p = static_cast<char*>(a.allocate(sizeof len + 1 + len, 1));
+  std::memcpy(p, &len, sizeof len);
+  p[sizeof len] = 0;
+  std::memcpy(p + sizeof len + 1, s.data(), len);
+  return {p + sizeof len};
+}
 
 static std::string escape(char c) {
   switch (c) {
@@ -211,7 +258,7 @@ static std::string escape(char c) {
   }
 }
 
-static std::string escape(const std::string& s) {
+static std::string escape(std::string_view s) {
   std::string ret;
   for (char c : s)
     ret += escape(c);
@@ -271,6 +318,10 @@ std::ostream& operator<<(std::ostream& os, token tok) {
   case tok_type_specifier:
     os << ':' << to_string(tok.getTypeSpecifier());
     break;
+
+  case tok_error:
+    os << ':' << toString(tok.getError());
+    break;
   }
   os << '>';
   return os;
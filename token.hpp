@@ -1,10 +1,13 @@
+#pragma once
+
 //
 // Manage names, types, and properties of tokens
 //
 
 #include "symbol.hpp"
+#include "location.hpp"
 
-enum token {
+enum token_name : std::uint8_t {
   // Punctuators
   tok_lBrace,
   tok_rBrace,
@@ -49,6 +52,7 @@ enum token {
   tok_character,
   tok_string,
   tok_type_specifier,
+  tok_error,
   tok_eof,
 
 };
@@ -87,10 +91,10 @@ enum logical_op {
 };
 
 enum radix {
-  binary = 2;
-  deciamal = 10;
-  hexadecimal = 16;
-}
+  binary = 2,
+  decimal = 10,
+  hexadecimal = 16,
+};
 
 const char* toString(token_name n);
 const char* toString(relational_op op);
@@ -101,66 +105,97 @@ const char* toString(logical_op op);
 const char* getSpelling(token_name n);
 
 
-
-struct integer_attr {
-  radix rad;
-  long long value;
+// The reason for a tok_error. The lexer reports these as tokens rather
+// than throwing, and carries on from the next safe point.
+enum lex_error : std::uint8_t {
+  err_invalid_character,
+  err_unterminated_escape,
+  err_invalid_escape,
+  err_unterminated_character,
+  err_empty_character,
+  err_multiline_character,
+  err_multibyte_character,
+  err_unterminated_string,
+  err_multiline_string,
+  err_integer_out_of_range,
+  err_floating_point_out_of_range,
 };
 
+const char* toString(lex_error e);
+
+
+
+// The text of a string literal. Literals are not interned; a later phase
+// that needs a symbol can intern str() itself.
+//
+// A literal with no escapes is left in the source: text points at its
+// opening quote, and the text runs to the closing one. Otherwise text
+// points at a NUL that separates the 32-bit length of an unescaped copy
+// from the copy itself.
 struct string_attr {
-  symbol sym;
+  const char* text;
+
+  bool isRaw() const { return *text == '"'; }
+  std::string_view str() const;
+
+  // Stores an unescaped copy of s in a.
+  static string_attr copy(arena& a, std::string_view s);
 };
 
 union token_attr {
-  token_attr() = default;
+  token_attr() : sym(nullptr) {}
   token_attr(symbol sym) : sym(sym) {}
   token_attr(relational_op op) : rel_op(op) {}
   token_attr(arithmetic_op op) : arith_op(op) {}
   token_attr(bitwise_op op) : bit_op(op) {}
   token_attr(logical_op op) : log_op(op) {}
-  token_attr(integer_attr val) : int_val(val) {}
+  token_attr(long long val) : int_val(val) {}
   token_attr(double val) : float_val(val) {}
   token_attr(bool tf) : tf_val(tf) {}
   token_attr(char c) : char_val(c) {}
   token_attr(string_attr s) : str_val(s) {}
   token_attr(type_spec ts) : ts(ts) {}
+  token_attr(lex_error e) : err(e) {}
 
   symbol sym;
   relational_op rel_op;
   arithmetic_op arith_op;
   bitwise_op bit_op;
   logical_op log_op;
-  integer_attr int_val;
+  long long int_val;
   double float_val;
   bool tf_val;
   char char_val;
   string_attr str_val;
   type_spec ts;
+  lex_error err;
 };
 
 class token {
 public:
   token();
-  token(token_name name);
-  token(token_name name, token_attr attr);
-  token(symbol sym);
-  token(relational_op op);
-  token(arithmetic_op op);
-  token(bitwise_op op);
-  token(logical_op op);
-  token(long long val);
-  token(radix rad, long long val);
-  token(token_name name, radix rad, long long val);
-  token(double val);
-  token(bool tf);
-  token(char c);
-  token(string_attr s);
-  token(type_spec ts);
+  token(token_name name, location loc);
+  token(token_name name, token_attr attr, location loc);
+  token(symbol sym, location loc);
+  token(relational_op op, location loc);
+  token(arithmetic_op op, location loc);
+  token(bitwise_op op, location loc);
+  token(logical_op op, location loc);
+  token(long long val, location loc);
+  token(radix rad, long long val, location loc);
+  token(token_name name, radix rad, long long val, location loc);
+  token(double val, location loc);
+  token(bool tf, location loc);
+  token(char c, location loc);
+  token(string_attr s, location loc);
+  token(type_spec ts, location loc);
+  token(lex_error e, location loc);
 
   operator bool() const { return m_name != tok_eof; }
 
   token_name getName() const { return m_name; }
   token_attr getAttribute() const { return m_attr; }
+  location getLocation() const { return {m_source, m_offset}; }
 
   bool isInteger() const;
   bool isFloatingPoint() const;
@@ -175,14 +210,21 @@ public:
   radix getRadix() const;
   bool getBoolean() const;
   char getChar() const;
-  const std::string& getString() const;
+  std::string_view getString() const;
   type_spec getTypeSpecifier() const;
+  lex_error getError() const;
 
 private:
-  token_name m_name;
+  // Packed into 16 bytes: the radix of an integer follows from its name,
+  // and the source id is narrowed to 16 bits (see location.hpp).
   token_attr m_attr;
+  std::uint32_t m_offset;
+  std::uint16_t m_source;
+  token_name m_name;
 };
 
+static_assert(sizeof(token) == 16, "token should fit in 16 bytes");
+
 inline bool token::isInteger() const {
   return m_name >= tok_binary_integer &&
          m_name <= tok_hexadecimal_integer;
@@ -219,12 +261,15 @@ inline logical_op token::getLogicalOperator() const {
 
 inline long long token::getInteger() const {
   assert(isInteger());
-  return m_attr.int_val.value;
+  return m_attr.int_val;
 }
 
 inline radix token::getRadix() const {
-  assert(isInteger());
-  return m_attr.int_val.radix;
+  switch (m_name) {
+    case tok_binary_integer:      return binary;
+    case tok_hexadecimal_integer: return hexadecimal;
+    default:                      assert(isInteger()); return decimal;
+  }
 }
 
 inline double token::getFloatingPoint() const {
@@ -242,9 +287,14 @@ inline char token::getChar() const {
   return m_name.char_val;
 }
 
-inline const std::string& token::getString() const {
+inline std::string_view token::getString() const {
   assert(m_name == tok_string);
-  return *m_attr.str_val.sym;
+  return m_attr.str_val.str();
+}
+
+inline lex_error token::getError() const {
+  assert(m_name == tok_error);
+  return m_attr.err;
 }
 
 inline type_spec token::getTypeSpecifier() const {
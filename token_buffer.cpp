@@ -0,0 +1,197 @@
+#include "token_buffer.hpp"
+
+#include <algorithm>
+
+token_buffer::token_buffer(const symbol_table& syms, std::uint16_t source,
+                           const char* text)
+    : m_syms(syms), m_source(source), m_text(text), m_dead_payloads(0) { }
+
+void token_buffer::push_back(const token& tok) {
+  assert(!tok || tok.getLocation().source == m_source);
+  token_attr attr = tok.getAttribute();
+  std::uint32_t a = 0;
+  switch (tok.getName()) {
+    case tok_relational_op:   a = attr.rel_op; break;
+    case tok_arithmetic_op:   a = attr.arith_op; break;
+    case tok_bitwise_op:      a = attr.bit_op; break;
+    case tok_logical_op:      a = attr.log_op; break;
+    case tok_type_specifier:  a = attr.ts; break;
+    case tok_error:           a = attr.err; break;
+    case tok_boolean:         a = attr.tf_val; break;
+    case tok_character:       a = (unsigned char)attr.char_val; break;
+    case tok_identifier:      a = attr.sym.getId(); break;
+
+    case tok_binary_integer:
+    case tok_decimal_integer:
+    case tok_hexadecimal_integer:
+    case tok_floating_point:
+      a = addPayload(attr);
+      break;
+
+    case tok_string:
+      if (attr.str_val.isRaw()) {
+        assert(attr.str_val.text == m_text + tok.getLocation().offset);
+        a = raw_string;
+      }
+      else
+        a = addPayload(string_attr::copy(m_strings, attr.str_val.str()));
+      break;
+
+    default:
+      break;
+  }
+
+  m_names.push_back(tok.getName());
+  m_attrs.push_back(a);
+  m_offsets.push_back(tok.getLocation().offset);
+}
+
+// Payload indexes are renumbered past the ones already here, and unescaped
+// strings are copied since they belong to the other buffer.
+void token_buffer::append(const token_buffer& other) {
+  replace(size(), size(), other);
+}
+
+void token_buffer::replace(std::size_t first, std::size_t last,
+                           const token_buffer& other) {
+  assert(other.m_source == m_source && other.m_text == m_text);
+  assert(first <= last && last <= size());
+
+  for (std::size_t i = first; i < last; ++i)
+    if (hasPayload(i))
+      ++m_dead_payloads;
+
+  std::vector<std::uint32_t> attrs(other.m_attrs);
+  for (std::size_t i = 0; i < attrs.size(); ++i) {
+    switch (other.m_names[i]) {
+      case tok_binary_integer:
+      case tok_decimal_integer:
+      case tok_hexadecimal_integer:
+      case tok_floating_point:
+        attrs[i] = addPayload(other.m_payloads[attrs[i]]);
+        break;
+
+      case tok_string:
+        if (attrs[i] != raw_string) {
+          std::string_view str = other.m_payloads[attrs[i]].str_val.str();
+          attrs[i] = addPayload(string_attr::copy(m_strings, str));
+        }
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  auto splice = [&](auto& to, const auto& from) {
+    to.erase(to.begin() + first, to.begin() + last);
+    to.insert(to.begin() + first, from.begin(), from.end());
+  };
+  splice(m_names, other.m_names);
+  splice(m_attrs, attrs);
+  splice(m_offsets, other.m_offsets);
+
+  if (m_dead_payloads > m_payloads.size() / 2)
+    compact();
+}
+
+bool token_buffer::hasPayload(std::size_t i) const {
+  switch (m_names[i]) {
+    case tok_binary_integer:
+    case tok_decimal_integer:
+    case tok_hexadecimal_integer:
+    case tok_floating_point:
+      return true;
+    case tok_string:
+      return m_attrs[i] != raw_string;
+    default:
+      return false;
+  }
+}
+
+// Rebuilds the side table and the string copies from the live tokens, so
+// that repeated edits do not grow them without bound.
+void token_buffer::compact() {
+  std::vector<token_attr> payloads;
+  payloads.reserve(m_payloads.size() - m_dead_payloads);
+  arena strings;
+  for (std::size_t i = 0; i < size(); ++i) {
+    if (!hasPayload(i))
+      continue;
+    token_attr attr = m_payloads[m_attrs[i]];
+    if (m_names[i] == tok_string)
+      attr = string_attr::copy(strings, attr.str_val.str());
+    m_attrs[i] = payloads.size();
+    payloads.push_back(attr);
+  }
+  m_payloads.swap(payloads);
+  m_strings.swap(strings);
+  m_dead_payloads = 0;
+}
+
+void token_buffer::rebase(const char* text, std::size_t first,
+                          std::int64_t delta) {
+  m_text = text;
+  for (std::size_t i = first; i < size(); ++i)
+    m_offsets[i] += delta;
+}
+
+std::size_t token_buffer::lowerBound(std::uint32_t offset) const {
+  return std::lower_bound(m_offsets.begin(), m_offsets.end(), offset) -
+         m_offsets.begin();
+}
+
+void token_buffer::takeErrors(std::vector<diagnostic>& diags) {
+  std::size_t out = 0;
+  for (std::size_t i = 0; i < size(); ++i) {
+    if (m_names[i] == tok_error) {
+      diags.push_back({getLocation(i), toString(lex_error(m_attrs[i]))});
+      continue;
+    }
+    m_names[out] = m_names[i];
+    m_attrs[out] = m_attrs[i];
+    m_offsets[out] = m_offsets[i];
+    ++out;
+  }
+  m_names.resize(out);
+  m_attrs.resize(out);
+  m_offsets.resize(out);
+}
+
+std::size_t token_buffer::getCapacity() const {
+  return m_names.capacity() * sizeof(token_name) +
+         m_attrs.capacity() * sizeof(std::uint32_t) +
+         m_offsets.capacity() * sizeof(std::uint32_t) +
+         m_payloads.capacity() * sizeof(token_attr) + m_strings.getCapacity();
+}
+
+token token_buffer::operator[](std::size_t i) const {
+  token_name n = m_names[i];
+  std::uint32_t a = m_attrs[i];
+  location loc = getLocation(i);
+  switch (n) {
+    case tok_relational_op:   return {relational_op(a), loc};
+    case tok_arithmetic_op:   return {arithmetic_op(a), loc};
+    case tok_bitwise_op:      return {bitwise_op(a), loc};
+    case tok_logical_op:      return {logical_op(a), loc};
+    case tok_type_specifier:  return {type_spec(a), loc};
+    case tok_error:           return {lex_error(a), loc};
+    case tok_boolean:         return {bool(a), loc};
+    case tok_character:       return {char(a), loc};
+    case tok_identifier:      return {m_syms[a], loc};
+
+    case tok_binary_integer:
+    case tok_decimal_integer:
+    case tok_hexadecimal_integer:
+    case tok_floating_point:
+      return {n, m_payloads[a], loc};
+
+    case tok_string:
+      if (a == raw_string)
+        return {string_attr{m_text + loc.offset}, loc};
+      return {n, m_payloads[a], loc};
+
+    default:
+      return {n, loc};
+  }
+}
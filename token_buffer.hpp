@@ -0,0 +1,88 @@
+#pragma once
+
+//
+// A pre-lexed sequence of tokens, stored column-wise
+//
+// The parser can lex a whole file up front and then look ahead by index
+// instead of copying tokens through a queue. Each token takes 9 bytes:
+// its name, a 32-bit attribute and its offset. Operators, specifiers,
+// booleans, characters, error codes and symbol ids fit in the attribute
+// itself; numbers and strings go in a side table and the attribute is
+// their index there. Every token comes from the same source, so its id is
+// stored once.
+//
+// The buffer keeps its own copy of unescaped string literals, so it can
+// outlive the lexer that produced it. Literals left in the source are
+// found from their offset in the text, which must stay alive; rebase()
+// moves the buffer to a new copy of the text after an edit.
+//
+
+#include "token.hpp"
+#include "diagnostic.hpp"
+
+#include <vector>
+
+class token_buffer {
+public:
+  token_buffer(const symbol_table& syms, std::uint16_t source,
+               const char* text);
+
+  void push_back(const token& tok);
+
+  // Appends the tokens of another buffer over the same source
+  void append(const token_buffer& other);
+
+  // Removes the error tokens, adding a diagnostic for each to diags
+  void takeErrors(std::vector<diagnostic>& diags);
+
+  // Replaces the tokens [first, last) with those of other, which must be
+  // over the same text. The payloads of the replaced tokens are reclaimed
+  // once they make up half of the side table.
+  void replace(std::size_t first, std::size_t last, const token_buffer& other);
+
+  // Moves the buffer to text, adding delta to the offsets of the tokens
+  // from index first on.
+  void rebase(const char* text, std::size_t first, std::int64_t delta);
+
+  // Returns the index of the first token at or after offset
+  std::size_t lowerBound(std::uint32_t offset) const;
+
+  std::size_t size() const { return m_names.size(); }
+  bool empty() const { return m_names.empty(); }
+
+  // The bytes the buffer has allocated, string copies included
+  std::size_t getCapacity() const;
+
+  token_name getName(std::size_t i) const { return m_names[i]; }
+  std::uint32_t getOffset(std::size_t i) const { return m_offsets[i]; }
+  location getLocation(std::size_t i) const { return {m_source, m_offsets[i]}; }
+
+  // Rebuilds the i'th token
+  token operator[](std::size_t i) const;
+
+private:
+  // The attribute of a string left in the text
+  static constexpr std::uint32_t raw_string = UINT32_MAX;
+
+  std::uint32_t addPayload(const token_attr& attr) {
+    m_payloads.push_back(attr);
+    return m_payloads.size() - 1;
+  }
+
+  bool hasPayload(std::size_t i) const;
+  void compact();
+
+  const symbol_table& m_syms;
+  std::uint16_t m_source;
+  const char* m_text;
+
+  std::vector<token_name> m_names;
+  std::vector<std::uint32_t> m_attrs;
+  std::vector<std::uint32_t> m_offsets;
+
+  // Integer, floating point and string values, and how many of them
+  // belong to tokens that have been replaced
+  std::vector<token_attr> m_payloads;
+  std::size_t m_dead_payloads;
+  arena m_strings;
+};
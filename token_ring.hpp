@@ -0,0 +1,85 @@
+#pragma once
+
+//
+// The parser's lookahead
+//
+// A fixed number of tokens in a ring, so that fetching and accepting a
+// token are an index update rather than deque block management. Tokens
+// accepted after mark() are kept until the mark is released, so the parser
+// can back up to it without lexing again. The ring does not grow: pushing
+// when lookahead and the kept tokens fill it throws, which bounds how far
+// the parser can speculate.
+//
+
+#include "token.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <stdexcept>
+
+template<std::size_t N>
+class token_ring {
+  static_assert(N && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+public:
+  token_ring() : m_first(0), m_last(0), m_keep(0), m_marks(0) { }
+
+  bool empty() const { return m_first == m_last; }
+  bool full() const { return m_last - m_keep == N; }
+
+  // The number of tokens not yet accepted
+  std::size_t size() const { return m_last - m_first; }
+
+  const token& front() const { return (*this)[0]; }
+  const token& back() const { return m_slots[(m_last - 1) & (N - 1)]; }
+
+  const token& operator[](std::size_t n) const {
+    assert(n < size());
+    return m_slots[(m_first + n) & (N - 1)];
+  }
+
+  void push_back(const token& tok) {
+    if (full())
+      throw std::length_error(
+          "lookahead or speculation exceeds the token ring");
+    m_slots[m_last++ & (N - 1)] = tok;
+  }
+
+  void pop_front() {
+    assert(!empty());
+    ++m_first;
+    if (!m_marks)
+      m_keep = m_first;
+  }
+
+  // Returns the current position for rewind(). Marks nest; the tokens
+  // after the outermost one are kept until every mark is released.
+  std::size_t mark() {
+    ++m_marks;
+    return m_first;
+  }
+
+  // Backs up to a position returned by mark() that is not yet released
+  void rewind(std::size_t pos) {
+    if (!m_marks || pos < m_keep || pos > m_first)
+      throw std::out_of_range("rewind to a position that is not kept");
+    m_first = pos;
+  }
+
+  void release() {
+    assert(m_marks);
+    if (!--m_marks)
+      m_keep = m_first;
+  }
+
+private:
+  token m_slots[N];
+
+  // Positions increase without wrapping and are reduced modulo N to index
+  // the slots. [m_first, m_last) are fetched but not accepted, and
+  // [m_keep, m_first) are accepted but kept for a rewind.
+  std::size_t m_first;
+  std::size_t m_last;
+  std::size_t m_keep;
+  unsigned m_marks;
+};
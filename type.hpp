@@ -1,3 +1,8 @@
+#pragma once
+
+#include "ast.hpp"
+#include "casting.hpp"
+
 #include <vector>
 
 class type {
@@ -43,40 +48,62 @@ using type_list = std::vector<type *>;
 
 struct bool_type : type {
   bool_type() : type(bool_kind) {}
+
+  static bool classof(const type *t) { return t->getKind() == bool_kind; }
 };
 
 struct char_type : type {
   char_type() : type(char_kind) {}
+
+  static bool classof(const type *t) { return t->getKind() == char_kind; }
 };
 
 struct int_type : type {
   int_type() : type(int_kind) {}
+
+  static bool classof(const type *t) { return t->getKind() == int_kind; }
 };
 
 struct float_type : type {
   float_type() : type(float_kind) {}
+
+  static bool classof(const type *t) { return t->getKind() == float_kind; }
 };
 
 struct ptr_type : type {
   ptr_type(type *t) : type(ptr_kind), m_elem(t) {}
   type *getElementType() const { return m_elem; }
   type *m_elem;
+
+  static bool classof(const type *t) { return t->getKind() == ptr_kind; }
 };
 
 struct ref_type : type {
   ref_type(type *t) : type(ref_kind), m_elem(t) {}
   type *getObjectType() const { return m_elem; }
   type *m_elem;
+
+  static bool classof(const type *t) { return t->getKind() == ref_kind; }
 };
 
-struct func_type : type {
-  func_type(const type_list &ps, type *ret)
-      : type(func_kind), m_parms(ps), m_ret(ret) {}
+// The parameter types follow the node (see trailing_objects).
+struct func_type : type, trailing_objects<func_type, type *> {
+  func_type(array_ref<type *> ps, type *ret)
+      : type(func_kind), m_num_parms(ps.size()), m_ret(ret) {
+    initTrailingObjects(ps);
+  }
 
-  const type_list &getParameterTypes() const { return m_parms; }
-  type_list &getParameterTypes() { return m_parms; }
+  array_ref<type *> getParameterTypes() const {
+    return {getTrailingObjects(), m_num_parms};
+  }
   type *getReturnType() const { return m_ret; }
 
-  type_list m_parms;
+  std::uint32_t m_num_parms;
   type *m_ret;
+
+  static bool classof(const type *t) { return t->getKind() == func_kind; }
 };
+
+// Types are unique within their ast_context, so structurally equal types
+// are the same object.
+inline bool isSameAs(const type *t1, const type *t2) { return t1 == t2; }